@@ -1,74 +1,167 @@
 #include "ConvertQuaternary.hpp"
+#include "ConvertRadix.hpp"
+#include "instrument.hpp"
+
+#include <array>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
 int convertQuaternary(int inputNum, bool inputType) {
-    // Extract 8 digits, padding leading zeros
-    int digits[8] = { 0 };
-    int temp = inputNum;
-    for (int i = 7; i >= 0; --i) {
-        digits[i] = temp % 10;
-        temp /= 10;
+    return (int)convertRadix<4, 8, 9>(inputNum, inputType);
+}
+
+// Maps a 4-digit decimal-coded group (0..9999) to its packed base-4 byte,
+// or 0xFFFF when any digit is 4..9
+static constexpr std::array<uint16_t, 10000> makeGroupTable() {
+    std::array<uint16_t, 10000> t{};
+    for (int x = 0; x < 10000; ++x) {
+        int packed = 0;
+        bool valid = true;
+        for (int k = 3, v = x; k >= 0; --k, v /= 10) {
+            int d = v % 10;
+            if (d > 3) valid = false;
+            packed |= (d & 3) << (2 * (3 - k));
+        }
+        t[x] = valid ? (uint16_t)packed : (uint16_t)0xFFFF;
     }
+    return t;
+}
 
-    // Precompute powers of 4 up to 4^9
-    long long pow4[10];
-    pow4[0] = 1;
-    for (int i = 1; i <= 9; ++i) {
-        pow4[i] = pow4[i - 1] * 4;
+// Decimal-coded value of the four base-4 digits packed in a byte (0xFF -> 3333)
+static constexpr std::array<int, 256> makeByteDigits() {
+    std::array<int, 256> t{};
+    for (int b = 0; b < 256; ++b) {
+        t[b] = ((b >> 6) & 3) * 1000 + ((b >> 4) & 3) * 100 + ((b >> 2) & 3) * 10 + (b & 3);
     }
+    return t;
+}
+
+static constexpr std::array<int, 256> byteDigits = makeByteDigits();
 
-    // Compute decimal value
-    long long val;
-    if (inputType) {  // 4's complement
-        long long uval = 0;
-        for (int i = 0; i < 8; ++i) {
-            uval += (long long)digits[i] * pow4[7 - i];
+// Result of convertQuaternary for every packed 8-digit base-4 index.
+// With digits limited to 0..3 the value falls straight out of the bits: the
+// 9-digit output is the low 18 bits of the value, in 4's complement, or of
+// (val + M) ^ M with M marking the odd (negative-weight) digits, in negative
+// quaternary. Each entry is a few operations, which keeps the table well inside
+// the compiler's constexpr budget even with sanitizer instrumentation.
+static constexpr std::array<int, 65536> makeResultTable(bool inputType) {
+    std::array<int, 65536> t{};
+    const int oddDigits = 0xCCCC;
+    for (int idx = 0; idx < 65536; ++idx) {
+        int bits;
+        if (inputType) {  // 4's complement in, negative quaternary out
+            int val = idx - (idx >= 32768 ? 65536 : 0);
+            bits = ((val + oddDigits) ^ oddDigits) & 0x3FFFF;
         }
-        val = uval;
-        if (digits[0] >= 2) {
-            val -= pow4[8];
+        else {  // negative quaternary in, 4's complement out
+            int val = (idx & 0x3333) - (idx & 0xCCCC);
+            bits = val & 0x3FFFF;
         }
+        t[idx] = ((bits >> 16) & 3) * 100000000 + byteDigits[(bits >> 8) & 255] * 10000 + byteDigits[bits & 255];
     }
-    else {  // Negative quaternary
-        val = 0;
-        long long pwr = 1;
-        for (int i = 7; i >= 0; --i) {
-            val += (long long)digits[i] * pwr;
-            pwr *= -4;
+    return t;
+}
+
+static constexpr std::array<uint16_t, 10000> groupTable = makeGroupTable();
+static constexpr std::array<int, 65536> resultTable[2] = { makeResultTable(false), makeResultTable(true) };
+
+int convertQuaternaryLUT(int inputNum, bool inputType) {
+    // Split into two 4-digit groups; anything outside 8 digits keeps the scalar semantics
+    if ((unsigned)inputNum <= 99999999u) {
+        unsigned hi = groupTable[(unsigned)inputNum / 10000];
+        unsigned lo = groupTable[(unsigned)inputNum % 10000];
+        if ((hi | lo) <= 0xFF) {
+            return resultTable[inputType][(hi << 8) | lo];
         }
     }
+    // Invalid digits (4..9) or negative input
+    INSTR_COUNT("p1.lut.fallbacks", 1);
+    return (int)convertRadix<4, 8, 9>(inputNum, inputType);
+}
+
+#if defined(__AVX2__)
+// Unsigned division of eight 32-bit lanes by 10 (multiply by 0xCCCCCCCD, shift by 35)
+static inline __m256i div10_epu32(__m256i x) {
+    const __m256i magic = _mm256_set1_epi32((int)0xCCCCCCCDu);
+    __m256i even = _mm256_srli_epi64(_mm256_mul_epu32(x, magic), 35);
+    __m256i odd = _mm256_srli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(x, 32), magic), 35);
+    return _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+}
 
-    // Convert to the other representation (9 digits)
-    int outd[9] = { 0 };
+// Converts eight non-negative inputs at once. Mirrors the scalar steps above:
+// every intermediate value fits in 32 bits for 8 decimal digits in 0..9.
+static inline __m256i convertQuaternary8(__m256i x, bool inputType) {
+    const __m256i ten = _mm256_set1_epi32(10);
+    const __m256i three = _mm256_set1_epi32(3);
+
+    // Extract 8 digits from the right, accumulating the value as we go
+    __m256i val = _mm256_setzero_si256();
+    __m256i lead = _mm256_setzero_si256();
+    for (int i = 7; i >= 0; --i) {
+        __m256i q = div10_epu32(x);
+        __m256i d = _mm256_sub_epi32(x, _mm256_mullo_epi32(q, ten));
+        int shift = 2 * (7 - i);
+        if (inputType || (7 - i) % 2 == 0) {
+            val = _mm256_add_epi32(val, _mm256_slli_epi32(d, shift));
+        }
+        else {
+            val = _mm256_sub_epi32(val, _mm256_slli_epi32(d, shift));
+        }
+        lead = d;
+        x = q;
+    }
+    if (inputType) {  // 4's complement sign from the leading digit
+        __m256i neg = _mm256_cmpgt_epi32(lead, _mm256_set1_epi32(1));
+        val = _mm256_sub_epi32(val, _mm256_and_si256(neg, _mm256_set1_epi32(65536)));
+    }
+
+    // Convert to the other representation (9 digits) and fold into decimal
+    __m256i result = _mm256_setzero_si256();
+    __m256i outd[9];
     if (!inputType) {  // Convert to 4's complement
-        long long uval2 = (val >= 0) ? val : pow4[9] + val;
-        long long temp_u = uval2;
+        __m256i neg = _mm256_cmpgt_epi32(_mm256_setzero_si256(), val);
+        __m256i u = _mm256_add_epi32(val, _mm256_and_si256(neg, _mm256_set1_epi32(262144)));
         for (int i = 8; i >= 0; --i) {
-            outd[i] = temp_u % 4;
-            temp_u /= 4;
+            outd[i] = _mm256_and_si256(u, three);
+            u = _mm256_srli_epi32(u, 2);
         }
     }
     else {  // Convert to negative quaternary
-        long long cval = val;
-        int base = -4;
-        int abase = 4;
+        __m256i c = val;
         for (int i = 8; i >= 0; --i) {
-            long long rem = cval % base;
-            if (rem < 0) rem += abase;
-            outd[i] = (int)rem;
-            cval = (cval - rem) / base;
+            outd[i] = _mm256_and_si256(c, three);
+            c = _mm256_sub_epi32(_mm256_setzero_si256(), _mm256_srai_epi32(c, 2));
         }
     }
-
-    // Build result int, ignoring leading zeros
-    int result = 0;
-    bool started = false;
     for (int i = 0; i < 9; ++i) {
-        if (outd[i] != 0 || started) {
-            started = true;
-            result = result * 10 + outd[i];
-        }
+        result = _mm256_add_epi32(_mm256_mullo_epi32(result, ten), outd[i]);
     }
-    if (!started) result = 0;
-
     return result;
-}
\ No newline at end of file
+}
+#endif
+
+void convertQuaternaryBatch(const int* in, int* out, size_t n, bool inputType) {
+    INSTR_SCOPE("p1.batch");
+    INSTR_COUNT("p1.batch.values", n);
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(in + i));
+        // Negative inputs produce negative digits; leave those to the scalar path
+        if (_mm256_movemask_ps(_mm256_castsi256_ps(x)) != 0) {
+            INSTR_COUNT("p1.batch.scalar_groups", 1);
+            for (size_t k = i; k < i + 8; ++k) {
+                out[k] = convertQuaternary(in[k], inputType);
+            }
+            continue;
+        }
+        _mm256_storeu_si256((__m256i*)(out + i), convertQuaternary8(x, inputType));
+    }
+#endif
+    for (; i < n; ++i) {
+        out[i] = convertQuaternary(in[i], inputType);
+    }
+}
@@ -5,6 +5,7 @@
 // iostream and string are already included for you.
 #include <iostream>
 #include <string>
+#include <cstddef>
 
 /*****************************************
 YOU MUST EDIT THE STUDENT ID BELOW!!!
@@ -18,4 +19,11 @@ int convertQuaternary(int inputNum, bool inputType); // The function you will ne
 
 // TODO: If you need additional helper functions, you can define them here
 
+// Same result as convertQuaternary, read from compile-time tables for valid 8-digit inputs.
+int convertQuaternaryLUT(int inputNum, bool inputType);
+
+// Converts n values from in[] into out[]; same results as calling convertQuaternary on each.
+// Uses AVX2 when compiled with -mavx2, otherwise falls back to the scalar function.
+void convertQuaternaryBatch(const int* in, int* out, size_t n, bool inputType);
+
 #endif // CONVERTQUATERNARY_HPP
\ No newline at end of file
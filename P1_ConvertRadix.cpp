@@ -0,0 +1,66 @@
+#include "ConvertRadix.hpp"
+
+#include <stdexcept>
+
+// Largest width radix_detail::maxDigits() allows for any base
+static constexpr int maxWidth = radix_detail::maxDigits(2);
+
+long long convertRadixRuntime(long long inputNum, bool inputType, int base, int inDigits, int outDigits) {
+    if (base < 2 || base > 16) throw std::invalid_argument("convertRadixRuntime: base must be in 2..16");
+    const int maxDigits = radix_detail::maxDigits(base);
+    if (inDigits < 1 || inDigits > maxDigits || outDigits < 1 || outDigits > maxDigits)
+        throw std::invalid_argument("convertRadixRuntime: digit width out of range for this base");
+    const long long code = base <= 10 ? 10 : base;
+
+    long long digits[maxWidth] = { 0 };
+    long long temp = inputNum;
+    for (int i = inDigits - 1; i >= 0; --i) {
+        digits[i] = temp % code;
+        temp /= code;
+    }
+
+    long long val = 0;
+    if (inputType) {  // Base's complement
+        long long pwr = 1;
+        for (int i = inDigits - 1; i >= 0; --i) {
+            val += digits[i] * pwr;
+            pwr *= base;
+        }
+        if (digits[0] >= base / 2) {
+            val -= pwr;
+        }
+    }
+    else {  // Negative base
+        long long pwr = 1;
+        for (int i = inDigits - 1; i >= 0; --i) {
+            val += digits[i] * pwr;
+            pwr *= -base;
+        }
+    }
+
+    long long outd[maxWidth] = { 0 };
+    if (!inputType) {  // Base's complement
+        long long full = 1;
+        for (int i = 0; i < outDigits; ++i) full *= base;
+        long long u = (val >= 0) ? val : full + val;
+        for (int i = outDigits - 1; i >= 0; --i) {
+            outd[i] = u % base;
+            u /= base;
+        }
+    }
+    else {  // Negative base
+        long long c = val;
+        for (int i = outDigits - 1; i >= 0; --i) {
+            long long rem = c % -base;
+            if (rem < 0) rem += base;
+            outd[i] = rem;
+            c = (c - rem) / -base;
+        }
+    }
+
+    long long result = 0;
+    for (int i = 0; i < outDigits; ++i) {
+        result = result * code + outd[i];
+    }
+    return result;
+}
@@ -0,0 +1,95 @@
+#ifndef CONVERTRADIX_HPP
+#define CONVERTRADIX_HPP
+
+#include <cstddef>
+#include <utility>
+
+// Generic complement <-> negative-base conversion.
+//
+// Numbers are passed digit-coded: each base-Base digit occupies one position of a
+// "code" radix, decimal for Base <= 10 (so base-4 10230 is the int 10230) and Base
+// itself above that (so base-16 digits are written as hex literals).
+//
+// inputType == true : input is InDigits-wide Base's complement, output is
+//                     OutDigits-wide negative base (-Base).
+// inputType == false: input is negative base, output is Base's complement.
+//
+// All loop bounds are template constants and the digit loops are expanded with
+// index sequences, so each instantiation compiles to straight-line code.
+// convertQuaternary is convertRadix<4, 8, 9>.
+
+namespace radix_detail {
+
+// Widest digit-coded number that fits in long long: 18 decimal-coded digits, or
+// 15 digits in a code radix of 11..16 (16^15 = 2^60)
+constexpr int maxDigits(int base) { return base <= 10 ? 18 : 15; }
+
+constexpr long long ipow(long long b, int e) {
+    long long r = 1;
+    for (int i = 0; i < e; ++i) r *= b;
+    return r;
+}
+
+} // namespace radix_detail
+
+template <int Base, int InDigits, int OutDigits>
+constexpr long long convertRadix(long long inputNum, bool inputType) {
+    static_assert(Base >= 2 && Base <= 16, "Base must be in 2..16");
+    static_assert(InDigits >= 1 && OutDigits >= 1, "digit widths must be positive");
+    constexpr long long Code = Base <= 10 ? 10 : Base;
+    static_assert(InDigits <= radix_detail::maxDigits(Base), "input does not fit in long long");
+    static_assert(OutDigits <= radix_detail::maxDigits(Base), "output does not fit in long long");
+
+    // Extract InDigits digits, padding leading zeros; digits[0] is the most significant
+    long long digits[InDigits] = {};
+    [&]<std::size_t... I>(std::index_sequence<I...>) {
+        long long temp = inputNum;
+        ((digits[InDigits - 1 - I] = temp % Code, temp /= Code), ...);
+    }(std::make_index_sequence<InDigits>{});
+
+    // Compute the signed value
+    long long val = 0;
+    if (inputType) {  // Base's complement
+        [&]<std::size_t... I>(std::index_sequence<I...>) {
+            ((val += digits[I] * radix_detail::ipow(Base, InDigits - 1 - I)), ...);
+        }(std::make_index_sequence<InDigits>{});
+        if (digits[0] >= Base / 2) {
+            val -= radix_detail::ipow(Base, InDigits);
+        }
+    }
+    else {  // Negative base
+        [&]<std::size_t... I>(std::index_sequence<I...>) {
+            ((val += digits[I] * radix_detail::ipow(-Base, InDigits - 1 - I)), ...);
+        }(std::make_index_sequence<InDigits>{});
+    }
+
+    // Convert to the other representation, least significant digit first
+    long long outd[OutDigits] = {};
+    if (!inputType) {  // Base's complement
+        long long u = (val >= 0) ? val : radix_detail::ipow(Base, OutDigits) + val;
+        [&]<std::size_t... I>(std::index_sequence<I...>) {
+            ((outd[OutDigits - 1 - I] = u % Base, u /= Base), ...);
+        }(std::make_index_sequence<OutDigits>{});
+    }
+    else {  // Negative base
+        long long c = val;
+        [&]<std::size_t... I>(std::index_sequence<I...>) {
+            ((outd[OutDigits - 1 - I] = c % -Base < 0 ? c % -Base + Base : c % -Base,
+              c = (c - outd[OutDigits - 1 - I]) / -Base), ...);
+        }(std::make_index_sequence<OutDigits>{});
+    }
+
+    // Re-encode in the code radix; leading zeros contribute nothing
+    long long result = 0;
+    [&]<std::size_t... I>(std::index_sequence<I...>) {
+        ((result = result * Code + outd[I]), ...);
+    }(std::make_index_sequence<OutDigits>{});
+    return result;
+}
+
+// Same conversion with base and widths chosen at runtime. Throws std::invalid_argument
+// unless base is in 2..16 and both widths are in 1..radix_detail::maxDigits(base)
+// (18 for base <= 10, 15 above).
+long long convertRadixRuntime(long long inputNum, bool inputType, int base, int inDigits, int outDigits);
+
+#endif // CONVERTRADIX_HPP
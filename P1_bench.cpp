@@ -0,0 +1,113 @@
+#include "ConvertQuaternary.hpp"
+#include "ConvertRadix.hpp"
+#include "instrument.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Benchmark for the quaternary conversion kernels.
+// Reports values/sec for each entry point against the scalar loop.
+
+// Random 8-digit decimal-coded quaternary numbers (digits 0..3)
+static std::vector<int> makeInputs(size_t n, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> digit(0, 3);
+    std::vector<int> v(n);
+    for (size_t i = 0; i < n; ++i) {
+        int x = 0;
+        for (int k = 0; k < 8; ++k) x = x * 10 + digit(rng);
+        v[i] = x;
+    }
+    return v;
+}
+
+// Random digit-coded inputs for convertRadix<Base, InDigits, ...>
+static std::vector<long long> makeRadixInputs(size_t n, int base, int inDigits, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> digit(0, base - 1);
+    const long long code = base <= 10 ? 10 : base;
+    std::vector<long long> v(n);
+    for (size_t i = 0; i < n; ++i) {
+        long long x = 0;
+        for (int k = 0; k < inDigits; ++k) x = x * code + digit(rng);
+        v[i] = x;
+    }
+    return v;
+}
+
+template <class F>
+static double valuesPerSec(F&& f, size_t n, int reps) {
+    auto t0 = std::chrono::steady_clock::now();
+    for (int r = 0; r < reps; ++r) f();
+    auto t1 = std::chrono::steady_clock::now();
+    double sec = std::chrono::duration<double>(t1 - t0).count();
+    return (double)n * reps / sec;
+}
+
+template <int Base, int InDigits, int OutDigits>
+static bool benchRadix(size_t n) {
+    const int reps = 3;
+    std::vector<long long> in = makeRadixInputs(n, Base, InDigits, 7u);
+    std::vector<long long> a(n), b(n);
+    std::printf("base %d, %d -> %d digits\n", Base, InDigits, OutDigits);
+    for (int type = 0; type <= 1; ++type) {
+        bool inputType = type != 0;
+        double runtime = valuesPerSec([&] {
+            for (size_t i = 0; i < n; ++i) a[i] = convertRadixRuntime(in[i], inputType, Base, InDigits, OutDigits);
+        }, n, reps);
+        double templ = valuesPerSec([&] {
+            for (size_t i = 0; i < n; ++i) b[i] = convertRadix<Base, InDigits, OutDigits>(in[i], inputType);
+        }, n, reps);
+        if (a != b) {
+            std::printf("MISMATCH: radix (inputType=%d)\n", type);
+            return false;
+        }
+        std::printf("  inputType=%d runtime: %.3e  template: %.3e values/sec\n", type, runtime, templ);
+    }
+    return true;
+}
+
+int main() {
+    const size_t n = 1 << 22;
+    const int reps = 5;
+    std::vector<int> in = makeInputs(n, 2025u);
+    std::vector<int> ref(n), out(n);
+
+    for (int type = 0; type <= 1; ++type) {
+        bool inputType = type != 0;
+        for (size_t i = 0; i < n; ++i) ref[i] = convertQuaternary(in[i], inputType);
+
+        double scalar = valuesPerSec([&] {
+            for (size_t i = 0; i < n; ++i) out[i] = convertQuaternary(in[i], inputType);
+        }, n, reps);
+        double lut = valuesPerSec([&] {
+            for (size_t i = 0; i < n; ++i) out[i] = convertQuaternaryLUT(in[i], inputType);
+        }, n, reps);
+        if (out != ref) {
+            std::printf("MISMATCH: lut (inputType=%d)\n", type);
+            return 1;
+        }
+        double batch = valuesPerSec([&] {
+            convertQuaternaryBatch(in.data(), out.data(), n, inputType);
+        }, n, reps);
+        if (out != ref) {
+            std::printf("MISMATCH: batch (inputType=%d)\n", type);
+            return 1;
+        }
+
+        std::printf("inputType=%d\n", type);
+        std::printf("  scalar: %.3e values/sec\n", scalar);
+        std::printf("  lut   : %.3e values/sec\n", lut);
+        std::printf("  batch : %.3e values/sec\n", batch);
+    }
+
+    // Specialized template instantiations against the runtime-parameterized engine
+    if (!benchRadix<2, 16, 17>(n) || !benchRadix<4, 8, 9>(n) ||
+        !benchRadix<8, 6, 7>(n) || !benchRadix<16, 4, 5>(n)) {
+        return 1;
+    }
+    instrument::report(stdout);
+    return 0;
+}
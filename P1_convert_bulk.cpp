@@ -0,0 +1,261 @@
+#include "ConvertQuaternary.hpp"
+#include "instrument.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Bulk converter for files of decimal-coded 8-digit numbers.
+//
+//   convert_bulk <input> <output> <inputType 0|1> [--binary] [--threads N] [--bench]
+//
+// Text input holds one number per line; the output holds one result per line.
+// With --binary, input and output are packed native int32 arrays.
+// The input is mmapped and split into chunks handed out to worker threads; each
+// worker converts its chunk straight into the mmapped output. --bench repeats the
+// conversion for 1, 2, 4, ... threads and reports throughput for each.
+
+struct MappedFile {
+    char* data = nullptr;
+    size_t size = 0;
+};
+
+static bool mapInput(const char* path, MappedFile& f) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0) { close(fd); return false; }
+    f.size = (size_t)st.st_size;
+    if (f.size > 0) {
+        void* p = mmap(nullptr, f.size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) { close(fd); return false; }
+        madvise(p, f.size, MADV_SEQUENTIAL);
+        f.data = (char*)p;
+    }
+    close(fd);
+    return true;
+}
+
+// Creates (or truncates) path at the given size and maps it; on failure the
+// partially created file is removed
+static bool mapOutput(const char* path, size_t size, MappedFile& f) {
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    if (ftruncate(fd, (off_t)size) != 0) { close(fd); unlink(path); return false; }
+    f.size = size;
+    if (size > 0) {
+        void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) { close(fd); unlink(path); return false; }
+        f.data = (char*)p;
+    }
+    close(fd);
+    return true;
+}
+
+static void unmap(MappedFile& f) {
+    if (f.data) munmap(f.data, f.size);
+    f.data = nullptr;
+}
+
+// Runs job(chunk) for chunk in [0, chunks) on a pool of workers pulling from a shared counter
+template <class F>
+static void parallelChunks(size_t chunks, int threads, F&& job) {
+    std::atomic<size_t> next{ 0 };
+    auto worker = [&] {
+        for (size_t c; (c = next.fetch_add(1)) < chunks;) job(c);
+    };
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; ++t) pool.emplace_back(worker);
+    worker();
+    for (std::thread& th : pool) th.join();
+}
+
+// Number of decimal characters in a conversion result (results are never negative
+// for unsigned 8-digit inputs, but keep the sign for '-' inputs)
+static inline size_t resultLength(int v) {
+    size_t len = v < 0 ? 1 : 0;
+    unsigned u = v < 0 ? 0u - (unsigned)v : (unsigned)v;
+    do { ++len; u /= 10; } while (u);
+    return len;
+}
+
+static inline char* writeResult(char* p, int v) {
+    size_t len = resultLength(v);
+    char* end = p + len;
+    unsigned u = v < 0 ? 0u - (unsigned)v : (unsigned)v;
+    char* q = end;
+    do { *--q = char('0' + u % 10); u /= 10; } while (u);
+    if (v < 0) *p = '-';
+    *end = '\n';
+    return end + 1;
+}
+
+static const size_t chunkBytes = 4u << 20;
+
+// Packed int32 in, packed int32 out. An input whose size is not a whole number
+// of int32 values is rejected before the output is created.
+static bool convertBinary(const MappedFile& in, const char* outPath, bool inputType, int threads) {
+    if (in.size % sizeof(int) != 0) {
+        std::fprintf(stderr, "ERROR: binary input is %zu bytes, not a multiple of %zu\n", in.size, sizeof(int));
+        return false;
+    }
+    size_t n = in.size / sizeof(int);
+    MappedFile out;
+    if (!mapOutput(outPath, n * sizeof(int), out)) {
+        std::fprintf(stderr, "ERROR: cannot write %s\n", outPath);
+        return false;
+    }
+    const int* src = (const int*)in.data;
+    int* dst = (int*)out.data;
+    const size_t per = chunkBytes / sizeof(int);
+    size_t chunks = (n + per - 1) / per;
+    parallelChunks(chunks, threads, [&](size_t c) {
+        INSTR_SCOPE("p1.bulk.binary_chunk");
+        size_t b = c * per, e = std::min(n, b + per);
+        for (size_t i = b; i < e; ++i) dst[i] = convertQuaternaryLUT(src[i], inputType);
+    });
+    unmap(out);
+    return true;
+}
+
+// Parses one line starting at a non-blank character: an optional '-', 1 to 8
+// digits and optional trailing blanks. Leaves p at the line's '\n' (or the end).
+// Returns false for a line with no digits, more than 8 digits or other characters.
+static inline bool parseLine(const char*& p, const char* end, int& v) {
+    bool neg = *p == '-';
+    if (neg) ++p;
+    v = 0;
+    int digits = 0;
+    while (p < end && *p >= '0' && *p <= '9' && digits < 8) { v = v * 10 + (*p++ - '0'); ++digits; }
+    bool ok = digits > 0;
+    for (; p < end && *p != '\n'; ++p) {
+        if (*p != ' ' && *p != '\r') ok = false;
+    }
+    if (neg) v = -v;
+    return ok;
+}
+
+static inline const char* skipBlanks(const char* p, const char* end) {
+    while (p < end && (*p == '\n' || *p == '\r' || *p == ' ')) ++p;
+    return p;
+}
+
+// Newline-separated text in and out. Pass 1 validates each chunk and measures its
+// output size; pass 2 parses and converts it again (the LUT makes that cheaper
+// than keeping the results) and writes straight into the mapping at its offset.
+// Any malformed line fails the whole conversion before the output is created.
+static bool convertText(const MappedFile& in, const char* outPath, bool inputType, int threads) {
+    const char* data = in.data;
+    const size_t size = in.size;
+
+    // Chunk boundaries, each moved forward to the start of a line
+    std::vector<size_t> bounds{ 0 };
+    for (size_t pos = chunkBytes; pos < size; pos += chunkBytes) {
+        const char* nl = (const char*)std::memchr(data + pos, '\n', size - pos);
+        size_t b = nl ? (size_t)(nl - data) + 1 : size;
+        if (b > bounds.back() && b < size) bounds.push_back(b);
+        if (b > pos) pos = b - 1;
+    }
+    bounds.push_back(size);
+    size_t chunks = bounds.size() - 1;
+
+    std::vector<size_t> outBytes(chunks + 1, 0);
+    std::vector<size_t> malformed(chunks, 0), firstBad(chunks, size);
+    parallelChunks(chunks, threads, [&](size_t c) {
+        INSTR_SCOPE("p1.bulk.measure_chunk");
+        size_t bytes = 0;
+        const char* end = data + bounds[c + 1];
+        for (const char* p = skipBlanks(data + bounds[c], end); p < end; p = skipBlanks(p, end)) {
+            const char* line = p;
+            int v;
+            if (!parseLine(p, end, v)) {
+                if (!malformed[c]++) firstBad[c] = (size_t)(line - data);
+                continue;
+            }
+            bytes += resultLength(convertQuaternaryLUT(v, inputType)) + 1;
+        }
+        outBytes[c + 1] = bytes;
+    });
+    size_t bad = 0;
+    for (size_t c = 0; c < chunks; ++c) {
+        if (malformed[c] && !bad) {
+            const char* line = data + firstBad[c];
+            const char* nl = (const char*)std::memchr(line, '\n', size - firstBad[c]);
+            int len = (int)std::min<size_t>(nl ? (size_t)(nl - line) : size - firstBad[c], 40);
+            std::fprintf(stderr, "ERROR: malformed line at byte %zu: \"%.*s\"\n", firstBad[c], len, line);
+        }
+        bad += malformed[c];
+    }
+    if (bad) {
+        std::fprintf(stderr, "ERROR: %zu malformed lines (expected an optional '-' and 1 to 8 digits per line)\n", bad);
+        return false;
+    }
+    for (size_t c = 0; c < chunks; ++c) outBytes[c + 1] += outBytes[c];
+
+    MappedFile out;
+    if (!mapOutput(outPath, outBytes[chunks], out)) {
+        std::fprintf(stderr, "ERROR: cannot write %s\n", outPath);
+        return false;
+    }
+    parallelChunks(chunks, threads, [&](size_t c) {
+        INSTR_SCOPE("p1.bulk.convert_chunk");
+        char* o = out.data + outBytes[c];
+        const char* end = data + bounds[c + 1];
+        for (const char* p = skipBlanks(data + bounds[c], end); p < end; p = skipBlanks(p, end)) {
+            int v;
+            parseLine(p, end, v);
+            o = writeResult(o, convertQuaternaryLUT(v, inputType));
+        }
+    });
+    unmap(out);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        std::fprintf(stderr, "usage: %s <input> <output> <inputType 0|1> [--binary] [--threads N] [--bench]\n", argv[0]);
+        return 1;
+    }
+    const char* inPath = argv[1];
+    const char* outPath = argv[2];
+    bool inputType = std::atoi(argv[3]) != 0;
+    bool binary = false, bench = false;
+    int threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 4; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--binary") == 0) binary = true;
+        else if (std::strcmp(argv[i], "--bench") == 0) bench = true;
+        else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threads = std::max(1, std::atoi(argv[++i]));
+        else { std::fprintf(stderr, "ERROR: unknown option %s\n", argv[i]); return 1; }
+    }
+
+    MappedFile in;
+    if (!mapInput(inPath, in)) { std::fprintf(stderr, "ERROR: cannot map %s\n", inPath); return 1; }
+
+    std::vector<int> counts;
+    if (bench) {
+        for (int t = 1; t < threads; t *= 2) counts.push_back(t);
+    }
+    counts.push_back(threads);
+
+    for (int t : counts) {
+        auto t0 = std::chrono::steady_clock::now();
+        bool ok = binary ? convertBinary(in, outPath, inputType, t) : convertText(in, outPath, inputType, t);
+        auto t1 = std::chrono::steady_clock::now();
+        if (!ok) { unmap(in); return 1; }
+        double sec = std::chrono::duration<double>(t1 - t0).count();
+        std::printf("threads=%d  %.3f s  %.1f MB/s\n", t, sec, (double)in.size / sec / 1e6);
+    }
+    unmap(in);
+    instrument::report(stdout);
+    return 0;
+}
@@ -1,4 +1,10 @@
 #include "SortFractions.hpp"
+#include "instrument.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#include <vector>
 
 // Helper function to compare two fractions, a and b.
 // Returns true if a should come before b, false otherwise.
@@ -35,14 +41,28 @@ bool compareFractions(int* a, int* b) {
 }
 
 
+// Scratch space for the original index of each slot. Small lists use a stack
+// buffer; larger ones reuse a per-thread buffer that only grows.
+static const int kStackScratch = 256;
+
+static int* originIndexScratch(int listSize, int* stackBuffer) {
+    if (listSize <= kStackScratch) return stackBuffer;
+    static thread_local std::vector<int> arena;
+    if ((int)arena.size() < listSize) arena.resize(listSize);
+    return arena.data();
+}
+
 void bubbleSortFractions(int** fracList, int listSize) {
-    // Keep track of the original pointers to set the backtracking pointers later.
-    int** original_locations = new int*[listSize];
+    INSTR_SCOPE("p2.bubble");
+    // Carry each fraction's original index alongside it to set the backtracking pointers later.
+    int stackBuffer[kStackScratch];
+    int* origin = originIndexScratch(listSize, stackBuffer);
     for (int i = 0; i < listSize; ++i) {
-        original_locations[i] = fracList[2 * i];
+        origin[i] = i;
     }
     
     // Non-optimized vanilla bubble sort
+    long long swaps = 0;
     for (int i = 0; i < listSize - 1; ++i) {
         for (int j = 0; j < listSize - i - 1; ++j) {
             // If the fraction at j+1 should come before the one at j, swap them.
@@ -51,28 +71,434 @@ void bubbleSortFractions(int** fracList, int listSize) {
                 int* temp = fracList[2 * j];
                 fracList[2 * j] = fracList[2 * (j + 1)];
                 fracList[2 * (j + 1)] = temp;
+
+                int tempOrigin = origin[j];
+                origin[j] = origin[j + 1];
+                origin[j + 1] = tempOrigin;
                 
                 // Increment flipCount for both fractions
                 fracList[2 * j][2]++;
                 fracList[2 * (j + 1)][2]++;
+                ++swaps;
             }
         }
     }
+    INSTR_COUNT("p2.bubble.compares", listSize > 1 ? (long long)listSize * (listSize - 1) / 2 : 0);
+    INSTR_COUNT("p2.bubble.swaps", swaps);
 
     // Set the backtracking pointers.
-    // For each final position 'k', find which original fraction is now there.
+    // The fraction that was originally at 'origin[k]' is now at 'k'.
+    for (int k = 0; k < listSize; ++k) {
+        fracList[2 * origin[k] + 1] = (int*)&fracList[2 * k];
+    }
+}
+
+// Stable merge sort of idx[lo, hi) by compareFractions. Every time an element from the
+// right half is placed before elements still waiting in the left half, those pairs are
+// exactly the adjacent swaps bubble sort would make, so both sides get their flips.
+static void mergeSortCounting(int** fracList, std::vector<int>& idx, std::vector<int>& tmp,
+                              std::vector<int>& flips, int lo, int hi) {
+    if (hi - lo < 2) return;
+    int mid = lo + (hi - lo) / 2;
+    mergeSortCounting(fracList, idx, tmp, flips, lo, mid);
+    mergeSortCounting(fracList, idx, tmp, flips, mid, hi);
+
+    int i = lo, j = mid, k = lo;
+    while (i < mid && j < hi) {
+        if (compareFractions(fracList[2 * idx[j]], fracList[2 * idx[i]])) {
+            flips[idx[j]] += mid - i;   // jumps over every remaining left element
+            tmp[k++] = idx[j++];
+        }
+        else {
+            flips[idx[i]] += j - mid;   // was jumped over by every right element taken so far
+            tmp[k++] = idx[i++];
+        }
+    }
+    while (i < mid) {
+        flips[idx[i]] += j - mid;
+        tmp[k++] = idx[i++];
+    }
+    while (j < hi) tmp[k++] = idx[j++];
+    for (k = lo; k < hi; ++k) idx[k] = tmp[k];
+}
+
+void mergeSortFractions(int** fracList, int listSize) {
+    if (listSize <= 0) return;
+    INSTR_SCOPE("p2.merge");
+
+    std::vector<int> idx(listSize), tmp(listSize), flips(listSize, 0);
+    for (int i = 0; i < listSize; ++i) idx[i] = i;
+    mergeSortCounting(fracList, idx, tmp, flips, 0, listSize);
+
+    // Move the fraction pointers into sorted order and apply the flip counts
+    std::vector<int*> original_locations(listSize);
+    for (int i = 0; i < listSize; ++i) {
+        original_locations[i] = fracList[2 * i];
+        original_locations[i][2] += flips[i];
+    }
+    for (int k = 0; k < listSize; ++k) {
+        fracList[2 * k] = original_locations[idx[k]];
+    }
+
+    // The fraction originally at idx[k] now lives at k
+    for (int k = 0; k < listSize; ++k) {
+        fracList[2 * idx[k] + 1] = (int*)&fracList[2 * k];
+    }
+}
+
+// Packed Cantor-order key: diagonal sum in the high 32 bits, then the numerator,
+// inverted on odd diagonals where the path runs towards smaller numerators.
+// For positive fractions two different fractions of equal value always lie on
+// different diagonals with the smaller numerator on the earlier one, so the
+// equal-value rule needs no extra bits and equal keys mean identical fractions.
+static inline uint64_t cantorKey(const int* f) {
+    uint64_t sum = (uint64_t)(uint32_t)f[0] + (uint64_t)(uint32_t)f[1];
+    uint32_t pos = (sum & 1) ? ~(uint32_t)f[0] : (uint32_t)f[0];
+    return (sum << 32) | pos;
+}
+
+void radixSortFractions(int** fracList, int listSize) {
+    if (listSize <= 0) return;
+
+    // The key only models compareFractions for positive numerators and denominators
+    for (int i = 0; i < listSize; ++i) {
+        if (fracList[2 * i][0] <= 0 || fracList[2 * i][1] <= 0) {
+            INSTR_COUNT("p2.radix.merge_fallbacks", 1);
+            mergeSortFractions(fracList, listSize);
+            return;
+        }
+    }
+
+    INSTR_SCOPE("p2.radix");
+    std::vector<uint64_t> keys(listSize), tmpKeys(listSize);
+    std::vector<int> idx(listSize), tmpIdx(listSize);
+    for (int i = 0; i < listSize; ++i) {
+        keys[i] = cantorKey(fracList[2 * i]);
+        idx[i] = i;
+    }
+
+    // LSD radix sort, 8 bits per pass; passes where every key shares the byte are skipped
+    for (int shift = 0; shift < 64; shift += 8) {
+        size_t count[257] = { 0 };
+        for (int i = 0; i < listSize; ++i) count[((keys[i] >> shift) & 0xFF) + 1]++;
+        if (count[((keys[0] >> shift) & 0xFF) + 1] == (size_t)listSize) continue;
+        for (int b = 0; b < 256; ++b) count[b + 1] += count[b];
+        for (int i = 0; i < listSize; ++i) {
+            size_t dst = count[(keys[i] >> shift) & 0xFF]++;
+            tmpKeys[dst] = keys[i];
+            tmpIdx[dst] = idx[i];
+        }
+        keys.swap(tmpKeys);
+        idx.swap(tmpIdx);
+    }
+
+    // Flip counts from final positions: fraction i meets every earlier fraction that
+    // ends up after it and every later fraction that ends up before it.
+    // A Fenwick tree over final positions counts the earlier ones that end up before it.
+    std::vector<int>& rank = tmpIdx;
+    for (int k = 0; k < listSize; ++k) rank[idx[k]] = k;
+    std::vector<int> tree(listSize + 1, 0);
+    std::vector<int*> original_locations(listSize);
+    for (int i = 0; i < listSize; ++i) {
+        int before = 0;
+        for (int p = rank[i]; p > 0; p -= p & -p) before += tree[p];
+        for (int p = rank[i] + 1; p <= listSize; p += p & -p) tree[p]++;
+        original_locations[i] = fracList[2 * i];
+        original_locations[i][2] += (i - before) + (rank[i] - before);
+    }
+
+    for (int k = 0; k < listSize; ++k) {
+        fracList[2 * k] = original_locations[idx[k]];
+    }
     for (int k = 0; k < listSize; ++k) {
-        int* current_fraction_ptr = fracList[2 * k];
-        // Find the original index of this fraction
-        for (int orig_idx = 0; orig_idx < listSize; ++orig_idx) {
-            if (original_locations[orig_idx] == current_fraction_ptr) {
-                // The fraction that was originally at 'orig_idx' is now at 'k'.
-                // Set the pointer in the original slot to point to the new location.
-                fracList[2 * orig_idx + 1] = (int*)&fracList[2 * k];
-                break;
+        fracList[2 * idx[k] + 1] = (int*)&fracList[2 * k];
+    }
+}
+
+// ---------- Structure-of-arrays parallel sort ----------
+
+// Sort item: the packed Cantor key of a fraction with positive terms
+struct KeyItem {
+    uint64_t key;
+    int idx;
+    int flips;
+    bool operator<(const KeyItem& o) const { return key < o.key; }
+};
+
+// Result of the merge sort fallback: original index and the flips it added
+struct SortedItem {
+    int idx;
+    int flips;
+};
+
+// Merges output positions [dBegin, dEnd) of the stable merge of L and R into out.
+// An element's flips only depend on its merged position, so any slice of the
+// output can be merged independently: a left element at L[i] landing at p was
+// jumped by p - i right elements, and a right element at R[j] landing at p jumps
+// the lenL - (p - j) left elements that are still behind it.
+template <class Item>
+static void mergeCountingRange(const Item* L, int lenL, const Item* R, int lenR,
+                               Item* out, int dBegin, int dEnd) {
+    // Merge path: number of left elements among the first d outputs
+    auto split = [&](int d) {
+        int lo = std::max(0, d - lenR), hi = std::min(d, lenL);
+        while (lo < hi) {
+            int mid = lo + (hi - lo) / 2;
+            if (!(R[d - mid - 1] < L[mid])) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo;
+    };
+    int i = split(dBegin), j = dBegin - i;
+    for (int p = dBegin; p < dEnd; ++p) {
+        if (j < lenR && (i == lenL || R[j] < L[i])) {
+            out[p] = R[j];
+            out[p].flips += lenL - (p - j);
+            ++j;
+        }
+        else {
+            out[p] = L[i];
+            out[p].flips += p - i;
+            ++i;
+        }
+    }
+}
+
+template <class F>
+static void runTasks(int tasks, int threads, F&& task) {
+    if (threads <= 1 || tasks <= 1) {
+        for (int t = 0; t < tasks; ++t) task(t);
+        return;
+    }
+    std::vector<std::thread> pool;
+    for (int w = 0; w < threads; ++w) {
+        pool.emplace_back([&, w] {
+            for (int t = w; t < tasks; t += threads) task(t);
+        });
+    }
+    for (std::thread& th : pool) th.join();
+}
+
+// Bottom-up counting merge sort of a[begin, end) using buf as scratch; result lands in a
+template <class Item>
+static void sortRunCounting(Item* a, Item* buf, int begin, int end) {
+    Item* src = a + begin;
+    Item* dst = buf + begin;
+    int n = end - begin;
+    for (int width = 1; width < n; width *= 2) {
+        for (int lo = 0; lo < n; lo += 2 * width) {
+            int mid = std::min(lo + width, n), hi = std::min(lo + 2 * width, n);
+            mergeCountingRange(src + lo, mid - lo, src + mid, hi - mid, dst + lo, 0, hi - lo);
+        }
+        std::swap(src, dst);
+    }
+    if (src != a + begin) std::copy(src, src + n, a + begin);
+}
+
+// Each thread sorts one run, then runs are merged pairwise with every merge split
+// into merge-path slices so all threads stay busy in every round
+template <class Item>
+static void parallelMergeSortCounting(std::vector<Item>& a, int threads) {
+    int n = (int)a.size();
+    std::vector<Item> buf(n);
+    int runs = std::max(1, std::min(threads, n / 4096));
+    std::vector<int> bounds(runs + 1);
+    for (int r = 0; r <= runs; ++r) bounds[r] = (int)((long long)n * r / runs);
+
+    runTasks(runs, threads, [&](int r) { sortRunCounting(a.data(), buf.data(), bounds[r], bounds[r + 1]); });
+
+    Item* src = a.data();
+    Item* dst = buf.data();
+    while (runs > 1) {
+        int pairs = runs / 2;
+        int slices = std::max(1, threads / pairs);
+        runTasks(pairs * slices + (runs % 2), threads, [&](int t) {
+            if (t == pairs * slices) {  // odd run out, copied through
+                std::copy(src + bounds[runs - 1], src + bounds[runs], dst + bounds[runs - 1]);
+                return;
             }
+            int pr = t / slices, sl = t % slices;
+            int lo = bounds[2 * pr], mid = bounds[2 * pr + 1], hi = bounds[2 * pr + 2];
+            int len = hi - lo;
+            int dBegin = (int)((long long)len * sl / slices), dEnd = (int)((long long)len * (sl + 1) / slices);
+            mergeCountingRange(src + lo, mid - lo, src + mid, hi - mid, dst + lo, dBegin, dEnd);
+        });
+        std::vector<int> next;
+        for (int r = 0; r <= runs; r += 2) next.push_back(bounds[r]);
+        if (runs % 2) next.push_back(bounds[runs]);
+        bounds.swap(next);
+        runs = (int)bounds.size() - 1;
+        std::swap(src, dst);
+    }
+    if (src != a.data()) std::copy(src, src + n, a.data());
+}
+
+template <class Item>
+static void scatterSorted(const std::vector<Item>& items, int* numerators, int* denominators,
+                          int* flips, int* order, int listSize) {
+    std::vector<int> num(numerators, numerators + listSize), den(denominators, denominators + listSize);
+    std::vector<int> flp(flips, flips + listSize);
+    for (int k = 0; k < listSize; ++k) {
+        int i = items[k].idx;
+        numerators[k] = num[i];
+        denominators[k] = den[i];
+        flips[k] = flp[i] + items[k].flips;
+        if (order) order[k] = i;
+    }
+}
+
+void sortFractionsSoA(int* numerators, int* denominators, int* flips, int listSize, int* order, int threads) {
+    if (listSize <= 0) return;
+    if (threads <= 0) threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    INSTR_SCOPE("p2.soa");
+
+    bool positive = true;
+    for (int i = 0; i < listSize && positive; ++i) {
+        positive = numerators[i] > 0 && denominators[i] > 0;
+    }
+    if (positive) {
+        std::vector<KeyItem> items(listSize);
+        for (int i = 0; i < listSize; ++i) {
+            int f[2] = { numerators[i], denominators[i] };
+            items[i] = { cantorKey(f), i, 0 };
+        }
+        parallelMergeSortCounting(items, threads);
+        scatterSorted(items, numerators, denominators, flips, order, listSize);
+    }
+    else {
+        // compareFractions is no strict weak ordering here, so the merge-path split
+        // has nothing to search; sort a temporary legacy list with mergeSortFractions
+        INSTR_COUNT("p2.soa.merge_fallbacks", 1);
+        std::vector<int> storage(3 * (size_t)listSize);
+        std::vector<int*> list(2 * (size_t)listSize, nullptr);
+        for (int i = 0; i < listSize; ++i) {
+            storage[3 * i] = numerators[i];
+            storage[3 * i + 1] = denominators[i];
+            list[2 * i] = &storage[3 * i];
+        }
+        mergeSortFractions(list.data(), listSize);
+        std::vector<SortedItem> items(listSize);
+        for (int k = 0; k < listSize; ++k) {
+            int i = (int)((list[2 * k] - storage.data()) / 3);
+            items[k] = { i, storage[3 * i + 2] };
+        }
+        scatterSorted(items, numerators, denominators, flips, order, listSize);
+    }
+}
+
+void writeBackFractions(int** fracList, const int* order, const int* flips, int listSize) {
+    std::vector<int*> original_locations(fracList, fracList + 2 * (size_t)listSize);
+    for (int k = 0; k < listSize; ++k) {
+        fracList[2 * k] = original_locations[2 * order[k]];
+        fracList[2 * k][2] = flips[k];
+    }
+    for (int k = 0; k < listSize; ++k) {
+        fracList[2 * order[k] + 1] = (int*)&fracList[2 * k];
+    }
+}
+
+void parallelSortFractions(int** fracList, int listSize, int threads) {
+    if (listSize <= 0) return;
+    std::vector<int> num(listSize), den(listSize), flips(listSize), order(listSize);
+    for (int i = 0; i < listSize; ++i) {
+        num[i] = fracList[2 * i][0];
+        den[i] = fracList[2 * i][1];
+        flips[i] = fracList[2 * i][2];
+    }
+    sortFractionsSoA(num.data(), den.data(), flips.data(), listSize, order.data(), threads);
+    writeBackFractions(fracList, order.data(), flips.data(), listSize);
+}
+
+// ---------- Streaming insertion ----------
+
+void FractionStream::push(int t) {
+    Node& n = nodes[t];
+    if (n.lazyFlips == 0) return;
+    if (n.left >= 0) { nodes[n.left].pendingFlips += n.lazyFlips; nodes[n.left].lazyFlips += n.lazyFlips; }
+    if (n.right >= 0) { nodes[n.right].pendingFlips += n.lazyFlips; nodes[n.right].lazyFlips += n.lazyFlips; }
+    n.lazyFlips = 0;
+}
+
+void FractionStream::update(int t) {
+    Node& n = nodes[t];
+    n.size = 1 + (n.left >= 0 ? nodes[n.left].size : 0) + (n.right >= 0 ? nodes[n.right].size : 0);
+}
+
+// Splits into fractions that bubble sort keeps before 'fraction' and those it passes
+void FractionStream::split(int t, int* fraction, int& lessEqual, int& greater) {
+    if (t < 0) { lessEqual = greater = -1; return; }
+    push(t);
+    if (compareFractions(fraction, nodes[t].fraction)) {
+        split(nodes[t].left, fraction, lessEqual, nodes[t].left);
+        greater = t;
+    }
+    else {
+        split(nodes[t].right, fraction, nodes[t].right, greater);
+        lessEqual = t;
+    }
+    update(t);
+}
+
+int FractionStream::merge(int a, int b) {
+    if (a < 0) return b;
+    if (b < 0) return a;
+    if (nodes[a].priority > nodes[b].priority) {
+        push(a);
+        nodes[a].right = merge(nodes[a].right, b);
+        update(a);
+        return a;
+    }
+    push(b);
+    nodes[b].left = merge(a, nodes[b].left);
+    update(b);
+    return b;
+}
+
+void FractionStream::insert(int* fraction) {
+    INSTR_SCOPE("p2.stream.insert");
+    seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+    int t = (int)nodes.size();
+    nodes.push_back({ fraction, -1, -1, 1, seed, 0, 0 });
+
+    int lessEqual, greater;
+    split(root, fraction, lessEqual, greater);
+    if (greater >= 0) {
+        // The newcomer swaps once with each fraction it passes
+        nodes[t].pendingFlips += nodes[greater].size;
+        nodes[greater].pendingFlips += 1;
+        nodes[greater].lazyFlips += 1;
+    }
+    root = merge(merge(lessEqual, t), greater);
+    last = t;
+}
+
+void FractionStream::flush(int** fracList) {
+    INSTR_SCOPE("p2.stream.flush");
+    // In-order walk with an explicit stack
+    std::vector<int> stack;
+    int lastPos = -1, k = 0;
+    int t = root;
+    while (t >= 0 || !stack.empty()) {
+        while (t >= 0) {
+            push(t);
+            stack.push_back(t);
+            t = nodes[t].left;
         }
+        t = stack.back();
+        stack.pop_back();
+        Node& n = nodes[t];
+        n.fraction[2] += n.pendingFlips;
+        n.pendingFlips = 0;
+        fracList[2 * k] = n.fraction;
+        if (t == last) lastPos = k;
+        ++k;
+        t = n.right;
     }
 
-    delete[] original_locations;
-}
\ No newline at end of file
+    // Before the last re-sort the newcomer sat at the end and everything else in order
+    int listSize = k;
+    for (k = 0; k < listSize; ++k) {
+        int origin = k == lastPos ? listSize - 1 : (k < lastPos ? k : k - 1);
+        fracList[2 * origin + 1] = (int*)&fracList[2 * k];
+    }
+}
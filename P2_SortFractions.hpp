@@ -5,6 +5,7 @@
 // iostream and string are already included for you.
 #include <iostream>
 #include <string>
+#include <vector>
 
 /*****************************************
 YOU MUST EDIT THE STUDENT ID BELOW!!!
@@ -18,4 +19,67 @@ void bubbleSortFractions(int** data, int listSize); // The function you will nee
 
 // TODO: If you need additional helper functions, you can define them here
 
+bool compareFractions(int* a, int* b); // true if fraction a comes before fraction b
+
+// Same final order, flip counts and backtracking pointers as bubbleSortFractions,
+// in O(n log n): each flip count is the number of inversions the fraction takes part in.
+// Exact for positive fractions; with zero or negative terms compareFractions is not a
+// strict weak ordering and the result can differ from bubble sort.
+void mergeSortFractions(int** data, int listSize);
+
+// Same results via an LSD radix sort over packed 64-bit Cantor-order keys.
+// Lists with a non-positive numerator or denominator fall back to mergeSortFractions.
+void radixSortFractions(int** data, int listSize);
+
+// Sorts contiguous numerator/denominator/flip arrays in place with a parallel merge sort,
+// adding the same flip counts bubble sort would. If order is given, order[k] receives the
+// original index of the fraction now at k. threads <= 0 uses every hardware thread.
+// Lists with a non-positive numerator or denominator are sorted by mergeSortFractions
+// instead (one thread, same results).
+void sortFractionsSoA(int* numerators, int* denominators, int* flips, int listSize,
+                      int* order = nullptr, int threads = 0);
+
+// Applies a sortFractionsSoA result to the legacy list: reorders the fraction pointers,
+// stores the flip counts and sets the backtracking pointers.
+void writeBackFractions(int** data, const int* order, const int* flips, int listSize);
+
+// Legacy-layout wrapper: copies to arrays, runs sortFractionsSoA and writes back.
+// threads <= 0 uses every hardware thread.
+void parallelSortFractions(int** data, int listSize, int threads = 0);
+
+// Keeps a growing list of fractions sorted as if bubbleSortFractions were re-run on
+// the sorted list with each new fraction appended at the end. An insert costs
+// O(log n) expected: a treap ordered by compareFractions, with the +1 flips of every
+// fraction the newcomer passes applied lazily to whole subtrees.
+// Fractions are caller-owned int[3]; pending flip counts reach them on flush.
+class FractionStream {
+public:
+    void insert(int* fraction);
+    int size() const { return (int)nodes.size(); }
+
+    // Writes the legacy layout (2 * size() slots) for the most recent re-sort and
+    // applies every pending flip count. O(n).
+    void flush(int** data);
+
+private:
+    struct Node {
+        int* fraction;
+        int left, right;
+        int size;
+        unsigned priority;
+        int pendingFlips;   // not yet added to fraction[2]
+        int lazyFlips;      // still to be added to every node below this one
+    };
+
+    void push(int t);
+    void update(int t);
+    void split(int t, int* fraction, int& lessEqual, int& greater);
+    int merge(int a, int b);
+
+    std::vector<Node> nodes;
+    int root = -1;
+    int last = -1;
+    unsigned seed = 2463534242u;
+};
+
 #endif // SORTFRACTIONS_HPP
\ No newline at end of file
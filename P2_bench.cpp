@@ -0,0 +1,192 @@
+#include "SortFractions.hpp"
+#include "instrument.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Benchmark for the fraction sorts.
+// Each fast mode is first checked against bubbleSortFractions on random lists
+// (order, flip counts and backtracking pointers), then timed at growing sizes.
+
+// Owns the fraction storage and the int** list in the layout the sorts expect:
+// even slots point to {numerator, denominator, flipCount}, odd slots are back-pointers.
+struct FractionList {
+    std::vector<int> storage;
+    std::vector<int*> list;
+
+    FractionList(int n, int maxValue, std::mt19937& rng, int minValue = 1)
+        : storage(3 * (size_t)n), list(2 * (size_t)n, nullptr) {
+        std::uniform_int_distribution<int> value(minValue, maxValue);
+        for (int i = 0; i < n; ++i) {
+            storage[3 * i] = value(rng);
+            storage[3 * i + 1] = value(rng);
+            storage[3 * i + 2] = 0;
+            list[2 * i] = &storage[3 * i];
+        }
+    }
+    FractionList(const FractionList& other) : storage(other.storage), list(other.list.size(), nullptr) {
+        for (size_t i = 0; i < list.size() / 2; ++i) list[2 * i] = &storage[3 * i];
+    }
+    int size() const { return (int)(list.size() / 2); }
+};
+
+// Compares two sorted lists that started as copies of each other
+static bool sameResult(const FractionList& a, const FractionList& b) {
+    for (int k = 0; k < a.size(); ++k) {
+        const int* fa = a.list[2 * k];
+        const int* fb = b.list[2 * k];
+        if (fa[0] != fb[0] || fa[1] != fb[1] || fa[2] != fb[2]) return false;
+        if (fa - a.storage.data() != fb - b.storage.data()) return false;
+        // Back-pointers as final positions
+        if ((int**)a.list[2 * k + 1] - a.list.data() != (int**)b.list[2 * k + 1] - b.list.data()) return false;
+    }
+    return true;
+}
+
+typedef void (*SortFn)(int**, int);
+
+static bool differential(const char* name, SortFn sort, std::mt19937& rng) {
+    std::uniform_int_distribution<int> sizeDist(0, 200);
+    for (int trial = 0; trial < 500; ++trial) {
+        // Small value ranges make equal values and duplicate fractions common
+        int maxValue = trial % 2 ? 6 : 50;
+        FractionList ref(sizeDist(rng), maxValue, rng);
+        FractionList test(ref);
+        bubbleSortFractions(ref.list.data(), ref.size());
+        sort(test.list.data(), test.size());
+        if (!sameResult(ref, test)) {
+            std::printf("MISMATCH: %s differs from bubble sort (trial %d, n=%d)\n", name, trial, ref.size());
+            return false;
+        }
+    }
+    std::printf("%s matches bubble sort on 500 random lists\n", name);
+    return true;
+}
+
+// The parallel sorts only split into several runs from 4096 fractions per thread on, so
+// the small lists above never reach the merge-path slicing or the inversions counted
+// across slices. Large lists with fixed thread counts (odd ones leave a run over) cover
+// that, checked against mergeSortFractions since bubble sort is too slow at this size.
+// Lists with zero or negative terms (values in -6..6) must take the merge sort fallback.
+static bool differentialParallel(std::mt19937& rng) {
+    for (int n : { 16384, 40000 }) {
+        for (int threads : { 2, 3, 4, 8 }) {
+            for (int maxValue : { 6, 1000, -6 }) {
+                FractionList ref = maxValue < 0 ? FractionList(n, -maxValue, rng, maxValue) : FractionList(n, maxValue, rng);
+                FractionList test(ref), soa(ref);
+                mergeSortFractions(ref.list.data(), n);
+
+                parallelSortFractions(test.list.data(), n, threads);
+                if (!sameResult(ref, test)) {
+                    std::printf("MISMATCH: parallel differs from merge sort (n=%d, threads=%d)\n", n, threads);
+                    return false;
+                }
+
+                std::vector<int> num(n), den(n), flips(n), order(n);
+                for (int i = 0; i < n; ++i) {
+                    num[i] = soa.storage[3 * i];
+                    den[i] = soa.storage[3 * i + 1];
+                    flips[i] = soa.storage[3 * i + 2];
+                }
+                sortFractionsSoA(num.data(), den.data(), flips.data(), n, order.data(), threads);
+                bool ok = true;
+                for (int k = 0; k < n && ok; ++k) {
+                    const int* f = ref.list[2 * k];
+                    ok = num[k] == f[0] && den[k] == f[1] && flips[k] == f[2];
+                }
+                writeBackFractions(soa.list.data(), order.data(), flips.data(), n);
+                if (!ok || !sameResult(ref, soa)) {
+                    std::printf("MISMATCH: sortFractionsSoA differs from merge sort (n=%d, threads=%d)\n", n, threads);
+                    return false;
+                }
+            }
+        }
+    }
+    std::printf("parallel and SoA match merge sort on multi-run lists (2 to 8 threads, with non-positive terms)\n");
+    return true;
+}
+
+// Streams fractions one at a time and compares against re-running bubble sort after each append
+static bool differentialStream(std::mt19937& rng) {
+    std::uniform_int_distribution<int> sizeDist(1, 150);
+    for (int trial = 0; trial < 300; ++trial) {
+        int maxValue = trial % 2 ? 6 : 50;
+        FractionList ref(sizeDist(rng), maxValue, rng);
+        FractionList test(ref);
+        FractionStream stream;
+        for (int n = 1; n <= ref.size(); ++n) {
+            bubbleSortFractions(ref.list.data(), n);
+            stream.insert(&test.storage[3 * (n - 1)]);
+        }
+        stream.flush(test.list.data());
+        if (!sameResult(ref, test)) {
+            std::printf("MISMATCH: stream differs from repeated bubble sort (trial %d, n=%d)\n", trial, ref.size());
+            return false;
+        }
+    }
+    std::printf("stream matches repeated bubble sort on 300 random lists\n");
+    return true;
+}
+
+static double seconds(SortFn sort, FractionList list) {
+    auto t0 = std::chrono::steady_clock::now();
+    sort(list.list.data(), list.size());
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(t1 - t0).count();
+}
+
+int main() {
+    std::mt19937 rng(2025u);
+    if (!differential("merge", mergeSortFractions, rng)) return 1;
+    if (!differential("radix", radixSortFractions, rng)) return 1;
+    SortFn parallel = [](int** data, int listSize) { parallelSortFractions(data, listSize); };
+    if (!differential("parallel", parallel, rng)) return 1;
+    if (!differentialParallel(rng)) return 1;
+    if (!differentialStream(rng)) return 1;
+
+    for (int n : { 1000, 10000, 100000, 1000000 }) {
+        FractionList list(n, 1000, rng);
+        std::printf("n=%d\n", n);
+        if (n <= 10000) std::printf("  bubble: %.4f s\n", seconds(bubbleSortFractions, list));
+        std::printf("  merge : %.4f s\n", seconds(mergeSortFractions, list));
+        std::printf("  radix : %.4f s\n", seconds(radixSortFractions, list));
+        std::printf("  parallel (int**): %.4f s\n", seconds(parallel, list));
+    }
+
+    // Sustained insert rate against re-sorting after every insert
+    for (int n : { 2000, 20000, 1000000 }) {
+        FractionList list(n, 1000, rng);
+        FractionStream stream;
+        auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < n; ++i) stream.insert(&list.storage[3 * i]);
+        stream.flush(list.list.data());
+        auto t1 = std::chrono::steady_clock::now();
+        std::printf("stream n=%d: %.3e inserts/sec\n", n, n / std::chrono::duration<double>(t1 - t0).count());
+        if (n <= 20000) {
+            FractionList again(n, 1000, rng);
+            t0 = std::chrono::steady_clock::now();
+            for (int i = 1; i <= n; ++i) radixSortFractions(again.list.data(), i);
+            t1 = std::chrono::steady_clock::now();
+            std::printf("re-sort (radix) n=%d: %.3e inserts/sec\n", n, n / std::chrono::duration<double>(t1 - t0).count());
+        }
+    }
+
+    // Structure-of-arrays sort alone, without the legacy round trip
+    const int n = 4000000;
+    std::vector<int> num(n), den(n), flips(n, 0);
+    std::uniform_int_distribution<int> value(1, 1000);
+    for (int i = 0; i < n; ++i) { num[i] = value(rng); den[i] = value(rng); }
+    unsigned hw = std::thread::hardware_concurrency();
+    for (int threads = 1; threads <= (int)std::max(1u, hw); threads *= 2) {
+        std::vector<int> a(num), b(den), f(flips);
+        auto t0 = std::chrono::steady_clock::now();
+        sortFractionsSoA(a.data(), b.data(), f.data(), n, nullptr, threads);
+        auto t1 = std::chrono::steady_clock::now();
+        std::printf("SoA n=%d threads=%d: %.4f s\n", n, threads, std::chrono::duration<double>(t1 - t0).count());
+    }
+    instrument::report(stdout);
+    return 0;
+}
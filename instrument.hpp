@@ -0,0 +1,207 @@
+// Lightweight instrumentation shared by all components: named stage timers and
+// event counters with a per-stage summary.
+//
+//   INSTR_SCOPE("q32.blur");             // times the enclosing scope
+//   INSTR_COUNT("p2.bubble.swaps", n);   // adds n to a counter
+//   instrument::report(stdout);          // summary of every stage and counter
+//
+// Everything is compiled in only with -DINSTRUMENT (make INSTRUMENT=1). Without it
+// the macros expand to nothing, their arguments are not evaluated, and report()
+// prints nothing. Stage timers record calls, wall time and cycles; cycles come from
+// the TSC on x86, or with -DINSTRUMENT_PERF on Linux from a per-thread perf_event
+// CPU-cycles counter (user space only), falling back to the TSC if perf is not
+// available. Each site updates relaxed atomics once per scope, so put scopes around
+// whole stages, rows or tiles rather than single samples.
+#pragma once
+
+#include <cstdio>
+
+#if defined(INSTRUMENT)
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <utility>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#if defined(INSTRUMENT_PERF) && defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#endif
+
+namespace instrument {
+
+#if defined(INSTRUMENT)
+
+struct Stage {
+    const char* name;
+    std::atomic<std::uint64_t> calls{ 0 }, ns{ 0 }, maxNs{ 0 }, cycles{ 0 };
+    explicit Stage(const char* n);
+};
+
+struct Counter {
+    const char* name;
+    std::atomic<std::uint64_t> value{ 0 };
+    explicit Counter(const char* n);
+};
+
+struct Registry {
+    std::mutex m;
+    std::vector<Stage*> stages;
+    std::vector<Counter*> counters;
+};
+
+inline Registry& registry() {
+    static Registry r;
+    return r;
+}
+
+inline Stage::Stage(const char* n) : name{ n } {
+    std::lock_guard<std::mutex> lock{ registry().m };
+    registry().stages.push_back(this);
+}
+
+inline Counter::Counter(const char* n) : name{ n } {
+    std::lock_guard<std::mutex> lock{ registry().m };
+    registry().counters.push_back(this);
+}
+
+#if defined(INSTRUMENT_PERF) && defined(__linux__)
+// CPU cycles of the calling thread, opened on first use
+struct PerfCycles {
+    int fd{ -1 };
+    PerfCycles() {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CPU_CYCLES;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = int(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+    ~PerfCycles() { if (fd >= 0) close(fd); }
+};
+#endif
+
+inline std::uint64_t cycles() {
+#if defined(INSTRUMENT_PERF) && defined(__linux__)
+    thread_local PerfCycles perf;
+    std::uint64_t v;
+    if (perf.fd >= 0 && read(perf.fd, &v, sizeof(v)) == sizeof(v)) return v;
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+inline const char* cycleSource() {
+#if defined(INSTRUMENT_PERF) && defined(__linux__)
+    thread_local PerfCycles probe;
+    if (probe.fd >= 0) return "perf cpu-cycles";
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+    return "tsc";
+#else
+    return "none";
+#endif
+}
+
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Stage& stage) : stage_{ stage }, c0_{ cycles() }, t0_{ std::chrono::steady_clock::now() } {}
+    ~ScopedTimer() {
+        const std::uint64_t ns{ std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - t0_).count()) };
+        const std::uint64_t c{ cycles() - c0_ };
+        stage_.calls.fetch_add(1, std::memory_order_relaxed);
+        stage_.ns.fetch_add(ns, std::memory_order_relaxed);
+        stage_.cycles.fetch_add(c, std::memory_order_relaxed);
+        std::uint64_t seen{ stage_.maxNs.load(std::memory_order_relaxed) };
+        while (ns > seen && !stage_.maxNs.compare_exchange_weak(seen, ns, std::memory_order_relaxed)) {}
+    }
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    Stage& stage_;
+    std::uint64_t c0_;
+    std::chrono::steady_clock::time_point t0_;
+};
+
+// One line per stage and per counter. Sites sharing a name (template instantiations,
+// the same stage in several places) are merged.
+inline void report(std::FILE* out) {
+    struct Row { const char* name; std::uint64_t calls, ns, maxNs, cycles; };
+    std::vector<Row> stages;
+    std::vector<std::pair<const char*, std::uint64_t>> counters;
+    {
+        std::lock_guard<std::mutex> lock{ registry().m };
+        for (const Stage* s : registry().stages) {
+            Row r{ s->name, s->calls.load(), s->ns.load(), s->maxNs.load(), s->cycles.load() };
+            auto it{ std::find_if(stages.begin(), stages.end(), [&](const Row& o) { return std::strcmp(o.name, r.name) == 0; }) };
+            if (it == stages.end()) { stages.push_back(r); continue; }
+            it->calls += r.calls; it->ns += r.ns; it->cycles += r.cycles; it->maxNs = std::max(it->maxNs, r.maxNs);
+        }
+        for (const Counter* c : registry().counters) {
+            auto it{ std::find_if(counters.begin(), counters.end(), [&](const auto& o) { return std::strcmp(o.first, c->name) == 0; }) };
+            if (it == counters.end()) counters.emplace_back(c->name, c->value.load());
+            else it->second += c->value.load();
+        }
+    }
+    auto byName = [](const auto& a, const auto& b) { return std::strcmp(a, b) < 0; };
+    std::sort(stages.begin(), stages.end(), [&](const Row& a, const Row& b) { return byName(a.name, b.name); });
+    std::sort(counters.begin(), counters.end(), [&](const auto& a, const auto& b) { return byName(a.first, b.first); });
+
+    std::fprintf(out, "Instrumentation (cycles: %s):\n", cycleSource());
+    std::fprintf(out, "  %-32s %10s %12s %12s %12s %14s\n", "stage", "calls", "total ms", "mean us", "max us", "Mcycles");
+    for (const Row& r : stages) {
+        if (!r.calls) continue;
+        std::fprintf(out, "  %-32s %10llu %12.3f %12.3f %12.3f %14.3f\n", r.name, (unsigned long long)r.calls,
+            r.ns / 1e6, r.ns / 1e3 / double(r.calls), r.maxNs / 1e3, r.cycles / 1e6);
+    }
+    for (const auto& [name, value] : counters) {
+        std::fprintf(out, "  %-32s %10llu\n", name, (unsigned long long)value);
+    }
+}
+
+// Zeroes every stage and counter, e.g. between benchmark phases
+inline void reset() {
+    std::lock_guard<std::mutex> lock{ registry().m };
+    for (Stage* s : registry().stages) { s->calls = 0; s->ns = 0; s->maxNs = 0; s->cycles = 0; }
+    for (Counter* c : registry().counters) c->value = 0;
+}
+
+#else
+
+inline void report(std::FILE*) {}
+inline void reset() {}
+
+#endif
+
+} // namespace instrument
+
+#define INSTR_CONCAT2(a, b) a##b
+#define INSTR_CONCAT(a, b) INSTR_CONCAT2(a, b)
+
+#if defined(INSTRUMENT)
+#define INSTR_SCOPE(name) \
+    static ::instrument::Stage INSTR_CONCAT(instrStage_, __LINE__){ name }; \
+    ::instrument::ScopedTimer INSTR_CONCAT(instrTimer_, __LINE__){ INSTR_CONCAT(instrStage_, __LINE__) }
+#define INSTR_COUNT(name, n) \
+    do { \
+        static ::instrument::Counter instrCounter_{ name }; \
+        instrCounter_.value.fetch_add(std::uint64_t(n), std::memory_order_relaxed); \
+    } while (0)
+#else
+#define INSTR_SCOPE(name) ((void)0)
+#define INSTR_COUNT(name, n) ((void)sizeof(n))
+#endif
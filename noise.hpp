@@ -0,0 +1,265 @@
+// Counter-based noise generation for synthetic test data (shared by q31 and q32).
+// Every random word comes from Philox4x32-10 keyed by the seed and addressed by the
+// sample index, so sample i gets the same noise whether the buffer is generated in
+// one pass, in chunks, or by any number of threads. Gaussian deviates use a
+// 128-layer ziggurat: one word per sample on the fast path, which is taken ~99% of
+// the time; the rare rejections draw from a second Philox stream of the same sample.
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "instrument.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace noise {
+
+// ---------- Philox4x32-10 ----------
+
+using Block = std::array<std::uint32_t, 4>;
+
+inline Block philox(Block c, std::uint64_t key) {
+    std::uint32_t k0{ std::uint32_t(key) }, k1{ std::uint32_t(key >> 32) };
+    for (int round{ 0 }; round < 10; ++round) {
+        const std::uint64_t p0{ std::uint64_t(0xD2511F53u) * c[0] };
+        const std::uint64_t p1{ std::uint64_t(0xCD9E8D57u) * c[2] };
+        c = { std::uint32_t(p1 >> 32) ^ c[1] ^ k0, std::uint32_t(p1), std::uint32_t(p0 >> 32) ^ c[3] ^ k1, std::uint32_t(p0) };
+        k0 += 0x9E3779B9u;
+        k1 += 0xBB67AE85u;
+    }
+    return c;
+}
+
+// Philox of kBatch consecutive main-stream blocks, word-major (out[word][block]).
+// Same values as philox(index0 + b, 0, 0, key).
+constexpr int kBatch{ 16 };
+
+inline void philoxBatch(std::uint64_t index0, std::uint64_t key, std::uint32_t (&out)[4][kBatch]) {
+    std::uint32_t c0[kBatch], c1[kBatch];
+    for (int b{ 0 }; b < kBatch; ++b) {
+        c0[b] = std::uint32_t(index0 + b);
+        c1[b] = std::uint32_t((index0 + b) >> 32);
+    }
+    std::uint32_t k0{ std::uint32_t(key) }, k1{ std::uint32_t(key >> 32) };
+#if defined(__AVX2__)
+    // 8 blocks per register; mul_epu32 multiplies the even lanes, so the odd lanes
+    // are shifted down for a second multiply and the halves blended back together
+    auto mulhilo = [](__m256i m, __m256i c, __m256i& hi, __m256i& lo) {
+        const __m256i even{ _mm256_mul_epu32(m, c) };
+        const __m256i odd{ _mm256_mul_epu32(m, _mm256_srli_epi64(c, 32)) };
+        lo = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+        hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+        };
+    const __m256i m0{ _mm256_set1_epi32(int(0xD2511F53u)) }, m1{ _mm256_set1_epi32(int(0xCD9E8D57u)) };
+    for (int g{ 0 }; g < kBatch; g += 8) {
+        __m256i x0{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(c0 + g)) };
+        __m256i x1{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(c1 + g)) };
+        __m256i x2{ _mm256_setzero_si256() }, x3{ _mm256_setzero_si256() };
+        std::uint32_t r0{ k0 }, r1{ k1 };
+        for (int round{ 0 }; round < 10; ++round) {
+            __m256i hi0, lo0, hi1, lo1;
+            mulhilo(m0, x0, hi0, lo0);
+            mulhilo(m1, x2, hi1, lo1);
+            x0 = _mm256_xor_si256(_mm256_xor_si256(hi1, x1), _mm256_set1_epi32(int(r0)));
+            x2 = _mm256_xor_si256(_mm256_xor_si256(hi0, x3), _mm256_set1_epi32(int(r1)));
+            x1 = lo1;
+            x3 = lo0;
+            r0 += 0x9E3779B9u;
+            r1 += 0xBB67AE85u;
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out[0] + g), x0);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out[1] + g), x1);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out[2] + g), x2);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out[3] + g), x3);
+    }
+#else
+    std::uint32_t c2[kBatch]{}, c3[kBatch]{};
+    for (int round{ 0 }; round < 10; ++round) {
+        for (int b{ 0 }; b < kBatch; ++b) {
+            const std::uint64_t p0{ std::uint64_t(0xD2511F53u) * c0[b] };
+            const std::uint64_t p1{ std::uint64_t(0xCD9E8D57u) * c2[b] };
+            const std::uint32_t n0{ std::uint32_t(p1 >> 32) ^ c1[b] ^ k0 }, n2{ std::uint32_t(p0 >> 32) ^ c3[b] ^ k1 };
+            c1[b] = std::uint32_t(p1);
+            c3[b] = std::uint32_t(p0);
+            c0[b] = n0;
+            c2[b] = n2;
+        }
+        k0 += 0x9E3779B9u;
+        k1 += 0xBB67AE85u;
+    }
+    for (int b{ 0 }; b < kBatch; ++b) { out[0][b] = c0[b]; out[1][b] = c1[b]; out[2][b] = c2[b]; out[3][b] = c3[b]; }
+#endif
+}
+
+// Words of sample-addressed block `index` in stream `stream` (0: main, 1: ziggurat retries)
+inline Block philox(std::uint64_t index, std::uint32_t stream, std::uint32_t attempt, std::uint64_t seed) {
+    return philox(Block{ std::uint32_t(index), std::uint32_t(index >> 32), stream, attempt }, seed);
+}
+
+// Uniform in (0, 1), never 0 so it is safe for log
+inline double uniformOpen(std::uint32_t w) { return (double(w) + 0.5) * (1.0 / 4294967296.0); }
+
+// ---------- Ziggurat (Marsaglia & Tsang, 128 layers, 24-bit magnitudes) ----------
+
+struct Ziggurat {
+    static constexpr double kR{ 3.442619855899 };       // start of the tail
+    static constexpr double kV{ 9.91256303526217e-3 };  // area of each layer
+    static constexpr double kScale{ 16777216.0 };       // 2^24
+    std::array<std::uint32_t, 128> k;   // fast-path acceptance thresholds
+    std::array<double, 128> w;          // magnitude -> x scale per layer
+    std::array<double, 128> f;          // exp(-x^2/2) at each layer edge
+
+    Ziggurat() {
+        double dn{ kR }, tn{ kR };
+        const double q{ kV / std::exp(-0.5 * dn * dn) };
+        k[0] = std::uint32_t(dn / q * kScale);
+        k[1] = 0;
+        w[0] = q / kScale;
+        w[127] = dn / kScale;
+        f[0] = 1.0;
+        f[127] = std::exp(-0.5 * dn * dn);
+        for (int i{ 126 }; i >= 1; --i) {
+            dn = std::sqrt(-2.0 * std::log(kV / dn + std::exp(-0.5 * dn * dn)));
+            k[i + 1] = std::uint32_t(dn / tn * kScale);
+            tn = dn;
+            f[i] = std::exp(-0.5 * dn * dn);
+            w[i] = dn / kScale;
+        }
+    }
+
+    static const Ziggurat& table() {
+        static const Ziggurat z;
+        return z;
+    }
+};
+
+// Slow path: wedge and tail rejections, fed by the retry stream of sample `index`
+inline double normalSlow(std::uint32_t word, std::uint64_t index, std::uint64_t seed) {
+    INSTR_COUNT("noise.ziggurat.slow_path", 1);
+    const Ziggurat& z{ Ziggurat::table() };
+    std::uint32_t attempt{ 0 };
+    for (;;) {
+        const int layer{ int(word & 127u) };
+        const double sign{ (word & 128u) ? -1.0 : 1.0 };
+        const std::uint32_t mag{ word >> 8 };
+        const double x{ double(mag) * z.w[layer] };
+        if (mag < z.k[layer]) return sign * x;
+        if (layer == 0) {
+            // Tail beyond kR, sampled by Marsaglia's exponential rejection
+            for (;;) {
+                const Block r{ philox(index, 1u, attempt++, seed) };
+                const double t{ -std::log(uniformOpen(r[0])) / Ziggurat::kR };
+                const double y{ -std::log(uniformOpen(r[1])) };
+                if (y + y >= t * t) return sign * (Ziggurat::kR + t);
+            }
+        }
+        const Block r{ philox(index, 1u, attempt++, seed) };
+        if (z.f[layer] + uniformOpen(r[0]) * (z.f[layer - 1] - z.f[layer]) < std::exp(-0.5 * x * x)) return sign * x;
+        word = r[1];
+    }
+}
+
+// Standard normal deviate from one random word; index and seed feed the slow path
+inline double normal(const Ziggurat& z, std::uint32_t word, std::uint64_t index, std::uint64_t seed) {
+    const int layer{ int(word & 127u) };
+    const std::uint32_t mag{ word >> 8 };
+    if (mag < z.k[layer]) {
+        const double x{ double(mag) * z.w[layer] };
+        return (word & 128u) ? -x : x;
+    }
+    return normalSlow(word, index, seed);
+}
+
+// ---------- Fills ----------
+
+constexpr std::size_t kNoiseChunk{ 1 << 16 };   // samples per parallel work item
+
+// Runs fn(begin, end) over [0, n) in fixed chunks; threads == 0 uses every hardware thread
+template <class F>
+void parallelChunks(std::size_t n, int threads, F&& fn) {
+    const std::size_t chunks{ (n + kNoiseChunk - 1) / kNoiseChunk };
+    if (threads <= 0) threads = int(std::max(1u, std::thread::hardware_concurrency()));
+    threads = int(std::min<std::size_t>(std::size_t(threads), chunks));
+    auto run = [&](std::size_t c) { fn(c * kNoiseChunk, std::min(n, (c + 1) * kNoiseChunk)); };
+    if (threads <= 1) {
+        for (std::size_t c{ 0 }; c < chunks; ++c) run(c);
+        return;
+    }
+    std::atomic<std::size_t> next{ 0 };
+    auto worker = [&] {
+        for (std::size_t c; (c = next.fetch_add(1)) < chunks;) run(c);
+        };
+    std::vector<std::thread> pool;
+    for (int t{ 1 }; t < threads; ++t) pool.emplace_back(worker);
+    worker();
+    for (std::thread& t : pool) t.join();
+}
+
+// x[i] += sigma * N(0, 1) for sample indices [first, first + n). Each Philox block
+// serves four consecutive samples; blocks are generated kBatch at a time.
+template <class T>
+void addGaussianRange(T* x, std::size_t n, double sigma, std::uint64_t seed, std::uint64_t first = 0) {
+    const Ziggurat& z{ Ziggurat::table() };
+    std::uint32_t w[4][kBatch];
+    const std::uint64_t end{ first + n };
+    for (std::uint64_t block0{ first / 4 }; block0 * 4 < end; block0 += kBatch) {
+        philoxBatch(block0, seed, w);
+        const std::uint64_t lo{ std::max(first, block0 * 4) }, hi{ std::min(end, (block0 + kBatch) * 4) };
+        for (std::uint64_t j{ lo }; j < hi; ++j) {
+            T& v{ x[j - first] };
+            v = T(double(v) + sigma * normal(z, w[j % 4][j / 4 - block0], j, seed));
+        }
+    }
+}
+
+template <class T>
+void addGaussian(T* x, std::size_t n, double sigma, std::uint64_t seed, int threads = 0) {
+    INSTR_SCOPE("noise.gaussian");
+    parallelChunks(n, threads, [&](std::size_t b, std::size_t e) { addGaussianRange(x + b, e - b, sigma, seed, b); });
+}
+
+// Gaussian noise followed by salt and pepper, as one pass over 8-bit samples:
+// px = clamp(round(px + sigma * N(0, 1))), then with probability `impulse` each
+// the sample becomes 0 (pepper) or 255 (salt).
+struct ImageNoise {
+    double sigma{ 18.0 };
+    double impulse{ 0.01 };
+};
+
+// Sample indices [first, first + n). Each Philox block serves two samples:
+// one word for the deviate and one for the impulse draw.
+inline void addImageNoiseRange(uint8_t* px, std::size_t n, const ImageNoise& params, std::uint64_t seed, std::uint64_t first = 0) {
+    const Ziggurat& z{ Ziggurat::table() };
+    const std::uint32_t threshold{ std::uint32_t(std::min(0.5, std::max(0.0, params.impulse)) * 4294967296.0) };
+    std::uint32_t w[4][kBatch];
+    const std::uint64_t end{ first + n };
+    for (std::uint64_t block0{ first / 2 }; block0 * 2 < end; block0 += kBatch) {
+        philoxBatch(block0, seed, w);
+        const std::uint64_t lo{ std::max(first, block0 * 2) }, hi{ std::min(end, (block0 + kBatch) * 2) };
+        for (std::uint64_t j{ lo }; j < hi; ++j) {
+            const std::uint64_t b{ j / 2 - block0 }, lane{ j % 2 };
+            const std::uint32_t u{ w[2 * lane + 1][b] };
+            uint8_t& p{ px[j - first] };
+            if (u < threshold) { p = 0; continue; }
+            if (u > ~threshold) { p = 255; continue; }
+            const double v{ std::floor(double(p) + params.sigma * normal(z, w[2 * lane][b], j, seed) + 0.5) };
+            p = uint8_t(std::clamp(v, 0.0, 255.0));
+        }
+    }
+}
+
+inline void addImageNoise(uint8_t* px, std::size_t n, const ImageNoise& params, std::uint64_t seed, int threads = 0) {
+    INSTR_SCOPE("noise.image");
+    parallelChunks(n, threads, [&](std::size_t b, std::size_t e) { addImageNoiseRange(px + b, e - b, params, seed, b); });
+}
+
+} // namespace noise
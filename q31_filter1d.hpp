@@ -0,0 +1,462 @@
+// 1D sliding-window filters with mirror padding (same rule as reflect_index)
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "instrument.hpp"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+namespace filter1d {
+
+// Mirror padding: -1 -> 1, n -> n-2
+inline int reflect(int i, int n) {
+    if (n <= 1) return 0;
+    while (i < 0 || i >= n) { i = (i < 0) ? -i : (2 * n - 2 - i); }
+    return i;
+}
+
+// Same rule for stream positions past 2^31
+inline long long reflect(long long i, long long n) {
+    if (n <= 1) return 0;
+    while (i < 0 || i >= n) { i = (i < 0) ? -i : (2 * n - 2 - i); }
+    return i;
+}
+
+// Windows up to this many taps are summed directly in window order, so the
+// 3-tap result is bit-identical to (a + b + c) / 3.0
+constexpr int kDirectSumTaps{ 7 };
+
+namespace detail {
+
+// acc + v * w for a weighted tap: one fused rounding on FMA targets, two elsewhere.
+// The vector lanes, the scalar loops and the streaming chain all take their taps
+// through madd, so whether the compiler would have contracted a multiply-add no
+// longer depends on which of them computed a sample.
+template <class T>
+T madd(T acc, T v, T w) {
+#if defined(__FMA__)
+    return std::fma(v, w, acc);
+#else
+    return acc + v * w;
+#endif
+}
+
+// Vector lanes for the interior stencil kernels. Every lane does the same IEEE
+// operations in the same order as the scalar loop (madd for weighted taps), so
+// results are bit-identical.
+template <class T> struct Lanes { static constexpr int width{ 1 }; };
+
+#if defined(__AVX512F__)
+template <> struct Lanes<double> {
+    using reg = __m512d;
+    static constexpr int width{ 8 };
+    static reg load(const double* p) { return _mm512_loadu_pd(p); }
+    static void store(double* p, reg v) { _mm512_storeu_pd(p, v); }
+    static reg set1(double v) { return _mm512_set1_pd(v); }
+    static reg add(reg a, reg b) { return _mm512_add_pd(a, b); }
+    static reg sub(reg a, reg b) { return _mm512_sub_pd(a, b); }
+    static reg mul(reg a, reg b) { return _mm512_mul_pd(a, b); }
+    static reg div(reg a, reg b) { return _mm512_div_pd(a, b); }
+    static reg madd(reg acc, reg v, reg w) { return _mm512_fmadd_pd(v, w, acc); }
+    // Blends rather than _mm512_min/max, which trip -Wmaybe-uninitialized in GCC 12;
+    // same selection as std::min / std::max
+    static reg min(reg a, reg b) { return _mm512_mask_blend_pd(_mm512_cmp_pd_mask(b, a, _CMP_LT_OQ), a, b); }
+    static reg max(reg a, reg b) { return _mm512_mask_blend_pd(_mm512_cmp_pd_mask(a, b, _CMP_LT_OQ), a, b); }
+    static unsigned inside(reg v, reg lo, reg hi) {
+        return _mm512_cmp_pd_mask(v, lo, _CMP_GT_OQ) & _mm512_cmp_pd_mask(v, hi, _CMP_LT_OQ);
+    }
+    static unsigned within(reg v, reg lo, reg hi) {
+        return _mm512_cmp_pd_mask(v, lo, _CMP_GE_OQ) & _mm512_cmp_pd_mask(v, hi, _CMP_LE_OQ);
+    }
+};
+template <> struct Lanes<float> {
+    using reg = __m512;
+    static constexpr int width{ 16 };
+    static reg load(const float* p) { return _mm512_loadu_ps(p); }
+    static void store(float* p, reg v) { _mm512_storeu_ps(p, v); }
+    static reg set1(float v) { return _mm512_set1_ps(v); }
+    static reg add(reg a, reg b) { return _mm512_add_ps(a, b); }
+    static reg sub(reg a, reg b) { return _mm512_sub_ps(a, b); }
+    static reg mul(reg a, reg b) { return _mm512_mul_ps(a, b); }
+    static reg div(reg a, reg b) { return _mm512_div_ps(a, b); }
+    static reg madd(reg acc, reg v, reg w) { return _mm512_fmadd_ps(v, w, acc); }
+    // Blends rather than _mm512_min/max, which trip -Wmaybe-uninitialized in GCC 12;
+    // same selection as std::min / std::max
+    static reg min(reg a, reg b) { return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(b, a, _CMP_LT_OQ), a, b); }
+    static reg max(reg a, reg b) { return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(a, b, _CMP_LT_OQ), a, b); }
+    static unsigned inside(reg v, reg lo, reg hi) {
+        return _mm512_cmp_ps_mask(v, lo, _CMP_GT_OQ) & _mm512_cmp_ps_mask(v, hi, _CMP_LT_OQ);
+    }
+    static unsigned within(reg v, reg lo, reg hi) {
+        return _mm512_cmp_ps_mask(v, lo, _CMP_GE_OQ) & _mm512_cmp_ps_mask(v, hi, _CMP_LE_OQ);
+    }
+};
+#elif defined(__AVX__)
+template <> struct Lanes<double> {
+    using reg = __m256d;
+    static constexpr int width{ 4 };
+    static reg load(const double* p) { return _mm256_loadu_pd(p); }
+    static void store(double* p, reg v) { _mm256_storeu_pd(p, v); }
+    static reg set1(double v) { return _mm256_set1_pd(v); }
+    static reg add(reg a, reg b) { return _mm256_add_pd(a, b); }
+    static reg sub(reg a, reg b) { return _mm256_sub_pd(a, b); }
+    static reg mul(reg a, reg b) { return _mm256_mul_pd(a, b); }
+    static reg div(reg a, reg b) { return _mm256_div_pd(a, b); }
+#if defined(__FMA__)
+    static reg madd(reg acc, reg v, reg w) { return _mm256_fmadd_pd(v, w, acc); }
+#else
+    static reg madd(reg acc, reg v, reg w) { return _mm256_add_pd(acc, _mm256_mul_pd(v, w)); }
+#endif
+    static reg min(reg a, reg b) { return _mm256_min_pd(a, b); }
+    static reg max(reg a, reg b) { return _mm256_max_pd(a, b); }
+    static unsigned inside(reg v, reg lo, reg hi) {
+        return unsigned(_mm256_movemask_pd(_mm256_and_pd(_mm256_cmp_pd(v, lo, _CMP_GT_OQ), _mm256_cmp_pd(v, hi, _CMP_LT_OQ))));
+    }
+    static unsigned within(reg v, reg lo, reg hi) {
+        return unsigned(_mm256_movemask_pd(_mm256_and_pd(_mm256_cmp_pd(v, lo, _CMP_GE_OQ), _mm256_cmp_pd(v, hi, _CMP_LE_OQ))));
+    }
+};
+template <> struct Lanes<float> {
+    using reg = __m256;
+    static constexpr int width{ 8 };
+    static reg load(const float* p) { return _mm256_loadu_ps(p); }
+    static void store(float* p, reg v) { _mm256_storeu_ps(p, v); }
+    static reg set1(float v) { return _mm256_set1_ps(v); }
+    static reg add(reg a, reg b) { return _mm256_add_ps(a, b); }
+    static reg sub(reg a, reg b) { return _mm256_sub_ps(a, b); }
+    static reg mul(reg a, reg b) { return _mm256_mul_ps(a, b); }
+    static reg div(reg a, reg b) { return _mm256_div_ps(a, b); }
+#if defined(__FMA__)
+    static reg madd(reg acc, reg v, reg w) { return _mm256_fmadd_ps(v, w, acc); }
+#else
+    static reg madd(reg acc, reg v, reg w) { return _mm256_add_ps(acc, _mm256_mul_ps(v, w)); }
+#endif
+    static reg min(reg a, reg b) { return _mm256_min_ps(a, b); }
+    static reg max(reg a, reg b) { return _mm256_max_ps(a, b); }
+    static unsigned inside(reg v, reg lo, reg hi) {
+        return unsigned(_mm256_movemask_ps(_mm256_and_ps(_mm256_cmp_ps(v, lo, _CMP_GT_OQ), _mm256_cmp_ps(v, hi, _CMP_LT_OQ))));
+    }
+    static unsigned within(reg v, reg lo, reg hi) {
+        return unsigned(_mm256_movemask_ps(_mm256_and_ps(_mm256_cmp_ps(v, lo, _CMP_GE_OQ), _mm256_cmp_ps(v, hi, _CMP_LE_OQ))));
+    }
+};
+#endif
+
+// y[i] = (sum_j x[i - r + j] * w[j]) / div for i in [begin, end); all taps in range.
+// A null w means unit weights without the multiply (the SMA sum).
+template <class T>
+void stencil(const T* x, T* y, int begin, int end, int r, const T* w, T div) {
+    const int k{ 2 * r + 1 };
+    int i{ begin };
+    if constexpr (Lanes<T>::width > 1) {
+        using L = Lanes<T>;
+        const auto vdiv{ L::set1(div) };
+        for (; i + L::width <= end; i += L::width) {
+            auto acc{ L::set1(T(0)) };
+            for (int j{ 0 }; j < k; ++j) {
+                auto v{ L::load(x + i - r + j) };
+                acc = w ? L::madd(acc, v, L::set1(w[j])) : L::add(acc, v);
+            }
+            L::store(y + i, L::div(acc, vdiv));
+        }
+    }
+    for (; i < end; ++i) {
+        T acc{ 0 };
+        for (int j{ 0 }; j < k; ++j) acc = w ? madd(acc, x[i - r + j], w[j]) : acc + x[i - r + j];
+        y[i] = acc / div;
+    }
+}
+
+// Same stencil for the few border samples, through the mirror
+template <class T>
+void stencilBorder(const T* x, T* y, int n, int begin, int end, int r, const T* w, T div) {
+    const int k{ 2 * r + 1 };
+    for (int i{ begin }; i < end; ++i) {
+        T acc{ 0 };
+        for (int j{ 0 }; j < k; ++j) {
+            T v{ x[reflect(i - r + j, n)] };
+            acc = w ? madd(acc, v, w[j]) : acc + v;
+        }
+        y[i] = acc / div;
+    }
+}
+
+// Runs the stencil on the interior with the vector kernel and on both borders with the mirror
+template <class T>
+void stencilMirrored(const std::vector<T>& x, std::vector<T>& y, int r, const T* w, T div) {
+    const int n{ int(x.size()) };
+    y.resize(x.size());
+    const int lo{ std::min(r, n) }, hi{ std::max(lo, n - r) };
+    stencilBorder(x.data(), y.data(), n, 0, lo, r, w, div);
+    stencil(x.data(), y.data(), lo, hi, r, w, div);
+    stencilBorder(x.data(), y.data(), n, hi, n, r, w, div);
+}
+
+} // namespace detail
+
+// Simple moving average over an odd window of k taps, for double or float signals.
+// Short windows are summed directly in window order (vectorized in the interior);
+// large windows keep a running sum: O(1) per sample. The running sum is kept in
+// double for float signals too, so its rounding error does not build up.
+template <class T>
+void sma(const std::vector<T>& x, std::vector<T>& y, int k) {
+    assert(k >= 1 && k % 2 == 1);
+    INSTR_SCOPE("q31.sma");
+    const int n{ int(x.size()) }, r{ k / 2 };
+    y.resize(x.size());
+    if (n == 0) return;
+    if (k <= kDirectSumTaps) {
+        detail::stencilMirrored<T>(x, y, r, nullptr, T(k));
+        return;
+    }
+    double acc{ 0 };
+    for (int o{ -r }; o <= r; ++o) acc += x[reflect(o, n)];
+    for (int i{ 0 }; i < n; ++i) {
+        y[i] = T(acc / double(k));
+        acc += double(x[reflect(i + r + 1, n)]) - double(x[reflect(i - r, n)]);
+    }
+}
+
+// Weighted moving average with an arbitrary odd-length kernel, normalized by the
+// weight sum. With {1, 2, 1} this is (a * 1.0 + b * 2.0 + c * 1.0) / 4.0.
+template <class T>
+void wma(const std::vector<T>& x, std::vector<T>& y, const std::vector<T>& w) {
+    assert(w.size() % 2 == 1);
+    INSTR_SCOPE("q31.wma");
+    T wsum{ 0 };
+    for (T v : w) wsum += v;
+    detail::stencilMirrored<T>(x, y, int(w.size()) / 2, w.data(), wsum);
+}
+
+// Sliding median over an odd window of k taps using two balanced multisets:
+// 'lo' holds the smallest (k + 1) / 2 values and its maximum is the median.
+// Each step inserts the entering value, then removes the leaving one (so 'lo' is
+// never empty, even for k = 1), O(log k) per sample.
+template <class T>
+void median(const std::vector<T>& x, std::vector<T>& y, int k) {
+    assert(k >= 1 && k % 2 == 1);
+    INSTR_SCOPE("q31.median");
+    const int n{ int(x.size()) }, r{ k / 2 };
+    y.resize(x.size());
+    if (n == 0) return;
+
+    std::multiset<T> lo, hi;
+    auto rebalance = [&] {
+        while (lo.size() > hi.size() + 1) { auto it{ std::prev(lo.end()) }; hi.insert(*it); lo.erase(it); }
+        while (lo.size() < hi.size() + 1) { auto it{ hi.begin() }; lo.insert(*it); hi.erase(it); }
+        };
+    auto add = [&](T v) {
+        if (lo.empty() || v <= *lo.rbegin()) lo.insert(v); else hi.insert(v);
+        rebalance();
+        };
+    auto remove = [&](T v) {
+        auto it{ lo.find(v) };
+        if (it != lo.end()) lo.erase(it); else hi.erase(hi.find(v));
+        rebalance();
+        };
+
+    for (int o{ -r }; o <= r; ++o) add(x[reflect(o, n)]);
+    for (int i{ 0 }; i < n; ++i) {
+        y[i] = *lo.rbegin();
+        if (i + 1 < n) {
+            add(x[reflect(i + r + 1, n)]);
+            remove(x[reflect(i - r, n)]);
+        }
+    }
+}
+
+// Switching median over an odd window of k taps: only samples that look like
+// impulses are replaced by the window median, every other sample is copied
+// through unchanged. A sample is a candidate when it sits on a clipping rail
+// (<= lo or >= hi) or lies more than threshold outside the range of its k - 1
+// neighbours. The candidate test is vectorized over the interior, so the median
+// is only computed at the (few) candidates. Returns the number of candidates.
+template <class T>
+std::size_t switchingMedian(const std::vector<T>& x, std::vector<T>& y, int k, T threshold,
+    T lo = std::numeric_limits<T>::lowest(), T hi = std::numeric_limits<T>::max()) {
+    assert(k >= 1 && k % 2 == 1);
+    INSTR_SCOPE("q31.switching_median");
+    const int n{ int(x.size()) }, r{ k / 2 };
+    y.assign(x.begin(), x.end());
+    if (n == 0 || r == 0) return 0;
+
+    std::vector<T> window(k);
+    std::size_t candidates{ 0 };
+    auto filter = [&](int i) {
+        for (int j{ 0 }; j < k; ++j) window[j] = x[reflect(i - r + j, n)];
+        std::nth_element(window.begin(), window.begin() + r, window.end());
+        y[i] = window[r];
+        ++candidates;
+        };
+    auto check = [&](int i) {
+        T nmin{ x[reflect(i - r, n)] }, nmax{ nmin };
+        for (int j{ 1 }; j < k; ++j) {
+            if (j == r) continue;
+            const T v{ x[reflect(i - r + j, n)] };
+            nmin = std::min(nmin, v); nmax = std::max(nmax, v);
+        }
+        const T v{ x[i] };
+        if (!(v > lo && v < hi && v >= nmin - threshold && v <= nmax + threshold)) filter(i);
+        };
+
+    const int begin{ std::min(r, n) }, end{ std::max(begin, n - r) };
+    int i{ 0 };
+    for (; i < begin; ++i) check(i);
+    if constexpr (detail::Lanes<T>::width > 1) {
+        using L = detail::Lanes<T>;
+        const auto vt{ L::set1(threshold) }, vlo{ L::set1(lo) }, vhi{ L::set1(hi) };
+        constexpr unsigned all{ (1u << L::width) - 1 };
+        for (; i + L::width <= end; i += L::width) {
+            auto nmin{ L::load(x.data() + i - r) }, nmax{ nmin };
+            for (int j{ 1 }; j < k; ++j) {
+                if (j == r) continue;
+                const auto v{ L::load(x.data() + i - r + j) };
+                nmin = L::min(nmin, v); nmax = L::max(nmax, v);
+            }
+            const auto v{ L::load(x.data() + i) };
+            const unsigned keep{ L::inside(v, vlo, vhi) & L::within(v, L::sub(nmin, vt), L::add(nmax, vt)) };
+            for (unsigned bits{ ~keep & all }; bits; bits &= bits - 1) {
+                filter(i + std::countr_zero(bits));
+            }
+        }
+    }
+    for (; i < n; ++i) check(i);
+    return candidates;
+}
+
+// Streaming SMA + WMA + median over an unbounded signal fed in chunks.
+// Only the last few samples needed by the next windows (the halo) are kept between
+// chunks, so memory stays constant. Output for sample j is emitted once sample
+// j + r has arrived (r = largest window radius); mirror padding is applied at the
+// start of the stream and, in finish(), at its end.
+// Results are bit-identical to sma / wma / median on the whole signal: every
+// output takes the same taps in the same order (weighted taps through
+// detail::madd, long SMA windows as the same running sum in double).
+// Samples are numbered from firstIndex (0 unless resuming a long stream's numbering);
+// positions are 64-bit, so streams longer than 2^31 samples mirror correctly.
+class StreamChain {
+public:
+    StreamChain(int smaTaps, std::vector<double> wmaWeights, int medianTaps, std::size_t firstIndex = 0)
+        : smaTaps_{ smaTaps }, medianTaps_{ medianTaps }, weights_{ std::move(wmaWeights) },
+          origin_{ firstIndex }, base_{ firstIndex }, received_{ firstIndex }, next_{ firstIndex } {
+        assert(smaTaps_ >= 1 && smaTaps_ % 2 == 1);
+        assert(medianTaps_ >= 1 && medianTaps_ % 2 == 1);
+        assert(weights_.size() % 2 == 1);
+        r_ = std::max({ smaTaps_ / 2, int(weights_.size()) / 2, medianTaps_ / 2 });
+        for (double v : weights_) wsum_ += v;
+    }
+
+    // Feeds n samples; writes up to n outputs to each of sma/wma/med and
+    // returns how many were written.
+    std::size_t push(const double* x, std::size_t n, double* sma, double* wma, double* med) {
+        INSTR_SCOPE("q31.stream.push");
+        compact();
+        buf_.insert(buf_.end(), x, x + n);
+        received_ += n;
+        std::size_t count{ 0 };
+        while (next_ + r_ < received_) emit(next_++, -1, sma, wma, med, count);
+        return count;
+    }
+
+    // Ends the stream: emits the remaining (at most r) outputs with mirror padding at the end.
+    std::size_t finish(double* sma, double* wma, double* med) {
+        std::size_t count{ 0 };
+        while (next_ < received_) emit(next_++, (long long)received_, sma, wma, med, count);
+        return count;
+    }
+
+private:
+    // Sample at global index g, mirrored at the start and (once the length is known) the end
+    double at(long long g, long long length) const {
+        const long long o{ (long long)origin_ };
+        if (length < 0) { if (g < o) g = 2 * o - g; }
+        else g = o + reflect(g - o, length - o);
+        return buf_[std::size_t(g - (long long)base_)];
+    }
+
+    void emit(std::size_t j, long long length, double* sma, double* wma, double* med, std::size_t& count) {
+        const long long c{ (long long)j };
+
+        const int rs{ smaTaps_ / 2 };
+        double acc{ 0.0 };
+        if (smaTaps_ <= kDirectSumTaps) {
+            for (int o{ -rs }; o <= rs; ++o) acc += at(c + o, length);
+        }
+        else {
+            if (j == origin_) { runningSum_ = 0.0; for (int o{ -rs }; o <= rs; ++o) runningSum_ += at(c + o, length); }
+            else runningSum_ += at(c + rs, length) - at(c - rs - 1, length);
+            acc = runningSum_;
+        }
+        sma[count] = acc / double(smaTaps_);
+
+        const int rw{ int(weights_.size()) / 2 };
+        double wacc{ 0.0 };
+        for (int k{ 0 }; k < int(weights_.size()); ++k) wacc = detail::madd(wacc, at(c - rw + k, length), weights_[k]);
+        wma[count] = wacc / wsum_;
+
+        const int rm{ medianTaps_ / 2 };
+        if (medianTaps_ <= kDirectSumTaps) {
+            std::array<double, kDirectSumTaps> w{};
+            for (int o{ -rm }; o <= rm; ++o) w[o + rm] = at(c + o, length);
+            std::nth_element(w.begin(), w.begin() + rm, w.begin() + medianTaps_);
+            med[count] = w[rm];
+        }
+        else {
+            if (j == origin_) { for (int o{ -rm }; o <= rm; ++o) addMedian(at(c + o, length)); }
+            else { removeMedian(at(c - rm - 1, length)); addMedian(at(c + rm, length)); }
+            med[count] = *lo_.rbegin();
+        }
+        ++count;
+    }
+
+    void rebalance() {
+        while (lo_.size() > hi_.size() + 1) { auto it{ std::prev(lo_.end()) }; hi_.insert(*it); lo_.erase(it); }
+        while (lo_.size() < hi_.size() + 1) { auto it{ hi_.begin() }; lo_.insert(*it); hi_.erase(it); }
+    }
+    void addMedian(double v) {
+        if (lo_.empty() || v <= *lo_.rbegin()) lo_.insert(v); else hi_.insert(v);
+        rebalance();
+    }
+    void removeMedian(double v) {
+        auto it{ lo_.find(v) };
+        if (it != lo_.end()) lo_.erase(it); else hi_.erase(hi_.find(v));
+        rebalance();
+    }
+
+    // Drops samples no future window can reach: the next window starts at next_ - r - 1
+    // (the running SMA and median also remove that one). Until r samples have been
+    // emitted the start mirror still needs everything from the first index.
+    void compact() {
+        std::size_t keepFrom{ next_ > origin_ + std::size_t(r_) + 1 ? next_ - std::size_t(r_) - 1 : origin_ };
+        if (keepFrom > base_) {
+            buf_.erase(buf_.begin(), buf_.begin() + std::ptrdiff_t(keepFrom - base_));
+            base_ = keepFrom;
+        }
+    }
+
+    int smaTaps_, medianTaps_;
+    std::vector<double> weights_;
+    double wsum_{ 0.0 };
+    int r_{ 0 };
+
+    std::vector<double> buf_;        // samples [base_, received_)
+    std::size_t origin_;             // index of the first sample
+    std::size_t base_, received_, next_;
+    double runningSum_{ 0.0 };
+    std::multiset<double> lo_, hi_;
+};
+
+} // namespace filter1d
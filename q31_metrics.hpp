@@ -0,0 +1,97 @@
+// Error metrics for 1D signals: MSE of many candidates against one reference.
+// The reference is read once: it is walked in blocks that stay in L1 while every
+// candidate is compared against the current block. Long signals are split into
+// fixed chunks scored in parallel; chunk partial sums are added in chunk order, so
+// the result does not depend on the thread count.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <initializer_list>
+#include <thread>
+#include <vector>
+
+#include "q31_filter1d.hpp"
+#include "instrument.hpp"
+
+namespace filter1d {
+
+constexpr std::size_t kMetricBlock{ 2048 };         // samples per L1-resident block
+constexpr std::size_t kMetricChunk{ 1 << 16 };      // samples per parallel work item
+
+namespace detail {
+
+// Sum of squared differences over [0, n), vector lanes then a fixed-order lane sum
+template <class T>
+double sumSquaredDiff(const T* a, const T* b, std::size_t n) {
+    std::size_t i{ 0 };
+    double total{ 0.0 };
+    if constexpr (Lanes<T>::width > 1) {
+        using L = Lanes<T>;
+        auto acc{ L::set1(T(0)) };
+        for (; i + L::width <= n; i += L::width) {
+            auto d{ L::sub(L::load(a + i), L::load(b + i)) };
+            acc = L::add(acc, L::mul(d, d));
+        }
+        alignas(64) T lanes[L::width];
+        L::store(lanes, acc);
+        for (T v : lanes) total += v;
+    }
+    for (; i < n; ++i) { double d{ double(a[i]) - double(b[i]) }; total += d * d; }
+    return total;
+}
+
+} // namespace detail
+
+// out[k] = mean((ref - tests[k])^2) over n samples, for k in [0, count).
+// threads == 0 uses every hardware thread; short signals stay on the caller.
+template <class T>
+void mseMany(const T* ref, const T* const* tests, int count, std::size_t n, double* out, int threads = 0) {
+    INSTR_SCOPE("q31.mse_many");
+    const std::size_t chunks{ (n + kMetricChunk - 1) / kMetricChunk };
+    std::vector<double> partial(chunks * count, 0.0);
+    auto scoreChunk = [&](std::size_t c) {
+        const std::size_t end{ std::min(n, (c + 1) * kMetricChunk) };
+        double* sums{ partial.data() + c * count };
+        for (std::size_t b{ c * kMetricChunk }; b < end; b += kMetricBlock) {
+            const std::size_t m{ std::min(kMetricBlock, end - b) };
+            for (int k{ 0 }; k < count; ++k) sums[k] += detail::sumSquaredDiff(ref + b, tests[k] + b, m);
+        }
+        };
+
+    if (threads <= 0) threads = int(std::max(1u, std::thread::hardware_concurrency()));
+    threads = int(std::min<std::size_t>(std::size_t(threads), chunks));
+    if (threads <= 1) {
+        for (std::size_t c{ 0 }; c < chunks; ++c) scoreChunk(c);
+    }
+    else {
+        std::atomic<std::size_t> next{ 0 };
+        auto worker = [&] {
+            for (std::size_t c; (c = next.fetch_add(1)) < chunks;) scoreChunk(c);
+            };
+        std::vector<std::thread> pool;
+        for (int t{ 1 }; t < threads; ++t) pool.emplace_back(worker);
+        worker();
+        for (std::thread& t : pool) t.join();
+    }
+
+    for (int k{ 0 }; k < count; ++k) {
+        double acc{ 0.0 };
+        for (std::size_t c{ 0 }; c < chunks; ++c) acc += partial[c * count + k];
+        out[k] = n ? acc / double(n) : 0.0;
+    }
+}
+
+template <class T>
+void mseMany(const std::vector<T>& ref, std::initializer_list<const std::vector<T>*> tests, double* out, int threads = 0) {
+    std::vector<const T*> ptrs;
+    for (const std::vector<T>* t : tests) {
+        assert(t->size() == ref.size());
+        ptrs.push_back(t->data());
+    }
+    mseMany(ref.data(), ptrs.data(), int(ptrs.size()), ref.size(), out, threads);
+}
+
+} // namespace filter1d
@@ -4,6 +4,8 @@
 #include "stb_image_write.h"
 
 #include <cassert>
+#include <bit>
+#include <climits>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
@@ -13,6 +15,12 @@
 #include <cmath>
 #include <random>
 #include <string>
+#include <chrono>
+
+#include "q31_filter1d.hpp"
+#include "q31_metrics.hpp"
+#include "noise.hpp"
+#include "instrument.hpp"
 
 // ---------- HELPER FUNCTIOS BELOW (DO NOT MODIFY) ----------
 template <class T> T clampv(T v, T lo, T hi) { return v < lo ? lo : (v > hi ? hi : v); }
@@ -145,7 +153,17 @@ constexpr double pi{ std::numbers::pi_v<double> };
 constexpr double pi{ 3.14159265358979323846 };
 #endif
 
-int main() {
+// Usage: q31 [--mt19937] [--bench]
+//   --mt19937: the original noise generator
+//   --bench:   also time the streaming chain, metrics and medians on long signals
+int main(int argc, char** argv) {
+    bool mt19937Noise{ false }, bench{ false };
+    for (int i{ 1 }; i < argc; ++i) {
+        const std::string arg{ argv[i] };
+        if (arg == "--mt19937") mt19937Noise = true;
+        else if (arg == "--bench") bench = true;
+        else { std::fprintf(stderr, "ERROR: unknown option %s\n", argv[i]); return 1; }
+    }
     const std::size_t N{ 257 };
 
     // Ground-truth signal: trend + two tones
@@ -163,7 +181,8 @@ int main() {
     {
         std::mt19937 rng{ 12345u };
         std::normal_distribution<double> gaus{ 0.0, 0.15 };
-        for (double& v : x_noisy) { v += gaus(rng); }
+        if (mt19937Noise) { for (double& v : x_noisy) { v += gaus(rng); } }
+        else noise::addGaussian(x_noisy.data(), N, 0.15, 12345u);
         for (int k{ 0 }; k < 6; ++k) {
             std::size_t i{ std::size_t((k + 1) * N / 7) };
             x_noisy[i] += (k % 2 ? 2.5 : -2.5);
@@ -172,60 +191,219 @@ int main() {
     }
 
     // TODO: implement denoisers using window **const references**
-    std::vector<double> y_sma{ x_noisy }, y_wma{ x_noisy }, y_med{ x_noisy };
+    std::vector<double> y_sma{ x_noisy }, y_wma{ x_noisy }, y_med{ x_noisy }, y_sw{ x_noisy };
 
     // --- Simple Moving Average ---
-    for (size_t i = 0; i < N; ++i) {
-        int i0{ reflect_index(static_cast<int>(i) - 1, static_cast<int>(N)) };
-        int i1{ static_cast<int>(i) };
-        int i2{ reflect_index(static_cast<int>(i) + 1, static_cast<int>(N)) };
-        
-        const double& a{ x_noisy[i0] };
-        const double& b{ x_noisy[i1] };
-        const double& c{ x_noisy[i2] };
-        
-        y_sma[i] = (a + b + c) / 3.0;
-    }
+    filter1d::sma(x_noisy, y_sma, 3);
 
     // --- Weighted Moving Average (use weight function: [1 2 1]/4) ---
-    for (size_t i = 0; i < N; ++i) {
-        int i0{ reflect_index(static_cast<int>(i) - 1, static_cast<int>(N)) };
-        int i1{ static_cast<int>(i) };
-        int i2{ reflect_index(static_cast<int>(i) + 1, static_cast<int>(N)) };
-
-        const double& a{ x_noisy[i0] };
-        const double& b{ x_noisy[i1] };
-        const double& c{ x_noisy[i2] };
-        
-        y_wma[i] = (a * 1.0 + b * 2.0 + c * 1.0) / 4.0;
-    }
+    filter1d::wma(x_noisy, y_wma, { 1.0, 2.0, 1.0 });
 
     // --- Median of three ---
-    for (size_t i = 0; i < N; ++i) {
-        int i0{ reflect_index(static_cast<int>(i) - 1, static_cast<int>(N)) };
-        int i1{ static_cast<int>(i) };
-        int i2{ reflect_index(static_cast<int>(i) + 1, static_cast<int>(N)) };
-
-        const double& a{ x_noisy[i0] };
-        const double& b{ x_noisy[i1] };
-        const double& c{ x_noisy[i2] };
-        
-        std::array<double, 3> window {a, b, c};
-        std::sort(window.begin(), window.end());
-        y_med[i] = window[1];
-    }
+    filter1d::median(x_noisy, y_med, 3);
 
+    // --- Switching median: median of three only at impulses and clipped samples ---
+    const std::size_t switched{ filter1d::switchingMedian(x_noisy, y_sw, 3, 0.5, -1.1, 1.1) };
 
     // Printing output text
+    // All five candidates scored in one pass over the clean signal
+    double err[5];
+    filter1d::mseMany(x_clean, { &x_noisy, &y_sma, &y_wma, &y_med, &y_sw }, err);
     std::printf("MSE vs clean:\n");
-    std::printf("  noisy : %.6f\n", mse(x_clean, x_noisy));
-    std::printf("  box   : %.6f\n", mse(x_clean, y_sma));
-    std::printf("  wavg  : %.6f\n", mse(x_clean, y_wma));
-    std::printf("  median: %.6f\n", mse(x_clean, y_med));
+    std::printf("  noisy : %.6f\n", err[0]);
+    std::printf("  box   : %.6f\n", err[1]);
+    std::printf("  wavg  : %.6f\n", err[2]);
+    std::printf("  median: %.6f\n", err[3]);
+    std::printf("  switch: %.6f  (%zu of %zu samples filtered)\n", err[4], switched, N);
 
     // Generating a PNG file with line profiles
-    plot_signals_png("signals.png", /*H_img=*/320, /*sx=*/3,
-        x_clean, x_noisy, y_sma, y_wma, y_med);
+    {
+        INSTR_SCOPE("q31.plot_png");
+        plot_signals_png("signals.png", /*H_img=*/320, /*sx=*/3,
+            x_clean, x_noisy, y_sma, y_wma, y_med);
+    }
     std::puts("Saved: signals.png (C=clean, N=noisy, B=box(SMA), W=wma, M=median)");
+
+    // Streaming: same three filters fused in one pass over fixed-size chunks
+    {
+        const std::size_t chunk{ 4096 };
+        filter1d::StreamChain chain{ 3, { 1.0, 2.0, 1.0 }, 3 };
+        std::vector<double> s_sma(chunk + 1), s_wma(chunk + 1), s_med(chunk + 1);
+        std::vector<double> z_sma, z_wma, z_med;
+        auto collect = [&](std::size_t m) {
+            z_sma.insert(z_sma.end(), s_sma.begin(), s_sma.begin() + m);
+            z_wma.insert(z_wma.end(), s_wma.begin(), s_wma.begin() + m);
+            z_med.insert(z_med.end(), s_med.begin(), s_med.begin() + m);
+            };
+        for (std::size_t i{ 0 }; i < N; i += 64) {
+            std::size_t m{ std::min<std::size_t>(64, N - i) };
+            collect(chain.push(x_noisy.data() + i, m, s_sma.data(), s_wma.data(), s_med.data()));
+        }
+        collect(chain.finish(s_sma.data(), s_wma.data(), s_med.data()));
+        bool same{ z_sma == y_sma && z_wma == y_wma && z_med == y_med };
+        std::printf("Streaming matches batch: %s\n", same ? "yes" : "NO");
+
+        // Stream positions past 2^31: number the samples from just below INT_MAX and
+        // compare against batch filters on the same samples (9 taps: running SMA and median)
+        {
+            const std::size_t first{ std::size_t(INT_MAX) - 1000 }, total{ 3000 };
+            std::vector<double> x(total), b_sma, b_wma, b_med;
+            for (std::size_t i{ 0 }; i < total; ++i) x[i] = x_noisy[i % N];
+            filter1d::sma(x, b_sma, 9);
+            filter1d::wma(x, b_wma, { 1.0, 2.0, 1.0 });
+            filter1d::median(x, b_med, 9);
+            filter1d::StreamChain farChain{ 9, { 1.0, 2.0, 1.0 }, 9, first };
+            z_sma.clear(); z_wma.clear(); z_med.clear();
+            for (std::size_t i{ 0 }; i < total; i += 64) {
+                std::size_t m{ std::min<std::size_t>(64, total - i) };
+                collect(farChain.push(x.data() + i, m, s_sma.data(), s_wma.data(), s_med.data()));
+            }
+            collect(farChain.finish(s_sma.data(), s_wma.data(), s_med.data()));
+            bool far{ z_sma == b_sma && z_wma == b_wma && z_med == b_med };
+            std::printf("Streaming past index 2^31 matches batch: %s\n", far ? "yes" : "NO");
+        }
+
+        // General WMA kernels (inexact weights, where a contracted multiply-add would
+        // round differently) and SMA lengths, fed in chunks of varying size
+        {
+            std::mt19937 rng{ 777u };
+            std::uniform_real_distribution<double> weight{ 0.01, 1.0 };
+            std::vector<double> x(1500), b_sma, b_wma, b_med;
+            for (std::size_t i{ 0 }; i < x.size(); ++i) x[i] = x_noisy[(i * 7) % N];
+            int mismatches{ 0 };
+            for (int trial{ 0 }; trial < 200; ++trial) {
+                const int taps{ 1 + 2 * int(rng() % 6) };
+                std::vector<double> w(std::size_t(1 + 2 * (rng() % 5)));
+                for (double& v : w) v = weight(rng);
+                filter1d::sma(x, b_sma, taps);
+                filter1d::wma(x, b_wma, w);
+                filter1d::median(x, b_med, taps);
+                filter1d::StreamChain c{ taps, w, taps };
+                z_sma.clear(); z_wma.clear(); z_med.clear();
+                for (std::size_t i{ 0 }; i < x.size();) {
+                    std::size_t m{ std::min<std::size_t>(1 + rng() % 64, x.size() - i) };
+                    collect(c.push(x.data() + i, m, s_sma.data(), s_wma.data(), s_med.data()));
+                    i += m;
+                }
+                collect(c.finish(s_sma.data(), s_wma.data(), s_med.data()));
+                if (!(z_sma == b_sma && z_wma == b_wma && z_med == b_med)) ++mismatches;
+            }
+            std::printf("Streaming matches batch for 200 random kernels: %s\n", mismatches ? "NO" : "yes");
+        }
+    }
+
+    // float32 signals: SMA and WMA within 1 ulp of scalar references, the window sum
+    // in window order (weighted taps through madd, like the filters) for direct sums
+    // and the exact sum for the running 31-tap SMA
+    {
+        const int total{ 1 << 20 };
+        std::vector<float> x(total), y;
+        for (int i{ 0 }; i < total; ++i) x[i] = float(100.0 + 10.0 * x_noisy[std::size_t(i) % N]);
+        auto ulps = [](float a, float b) {
+            auto key = [](float f) { const std::int32_t i{ std::bit_cast<std::int32_t>(f) }; return i < 0 ? -(long long)(i & INT32_MAX) : (long long)i; };
+            return std::llabs(key(a) - key(b));
+            };
+        auto at = [&](int i) { return x[filter1d::reflect(i, total)]; };
+        long long worst{ 0 };
+        for (int k : { 3, 7, 31 }) {
+            filter1d::sma(x, y, k);
+            for (int i{ 0 }; i < total; ++i) {
+                float ref;
+                if (k <= filter1d::kDirectSumTaps) {
+                    float acc{ 0 };
+                    for (int j{ -k / 2 }; j <= k / 2; ++j) acc += at(i + j);
+                    ref = acc / float(k);
+                }
+                else {
+                    double acc{ 0 };
+                    for (int j{ -k / 2 }; j <= k / 2; ++j) acc += at(i + j);
+                    ref = float(acc / k);
+                }
+                worst = std::max(worst, ulps(y[i], ref));
+            }
+        }
+        for (const std::vector<float>& w : { std::vector<float>{ 1.0f, 2.0f, 1.0f },
+                                             std::vector<float>{ 0.1f, 0.3f, 0.7f, 1.3f, 0.7f, 0.3f, 0.1f } }) {
+            filter1d::wma(x, y, w);
+            float wsum{ 0 };
+            for (float v : w) wsum += v;
+            const int r{ int(w.size()) / 2 };
+            for (int i{ 0 }; i < total; ++i) {
+                float acc{ 0 };
+                for (int j{ 0 }; j < int(w.size()); ++j) acc = filter1d::detail::madd(acc, at(i - r + j), w[j]);
+                worst = std::max(worst, ulps(y[i], acc / wsum));
+            }
+        }
+        std::printf("float SMA/WMA within 1 ulp of scalar: %s (worst %lld ulp)\n", worst <= 1 ? "yes" : "NO", worst);
+    }
+
+    // A 1-tap median is the signal itself
+    {
+        std::vector<double> x(2827), y;
+        for (std::size_t i{ 0 }; i < x.size(); ++i) x[i] = x_noisy[i % N];
+        filter1d::median(x, y, 1);
+        std::printf("Median of 1 tap returns the signal: %s\n", y == x ? "yes" : "NO");
+    }
+
+    if (!bench) {
+        instrument::report(stdout);
+        return 0;
+    }
+
+    // Streaming throughput on a long stream made of repeated noisy blocks
+    {
+        const std::size_t chunk{ 4096 }, total{ std::size_t(1) << 24 };
+        std::vector<double> s_sma(chunk + 1), s_wma(chunk + 1), s_med(chunk + 1);
+        filter1d::StreamChain longChain{ 3, { 1.0, 2.0, 1.0 }, 3 };
+        std::vector<double> block(chunk);
+        for (std::size_t i{ 0 }; i < chunk; ++i) block[i] = x_noisy[i % N];
+        double checksum{ 0.0 };
+        auto t0{ std::chrono::steady_clock::now() };
+        for (std::size_t done{ 0 }; done < total; done += chunk) {
+            std::size_t m{ longChain.push(block.data(), chunk, s_sma.data(), s_wma.data(), s_med.data()) };
+            if (m) checksum += s_sma[m - 1] + s_wma[m - 1] + s_med[m - 1];
+        }
+        longChain.finish(s_sma.data(), s_wma.data(), s_med.data());
+        auto t1{ std::chrono::steady_clock::now() };
+        double sec{ std::chrono::duration<double>(t1 - t0).count() };
+        std::printf("Streaming throughput: %.3e samples/sec (chunk=%zu, checksum %.3f)\n",
+            double(total) / sec, chunk, checksum);
+    }
+
+    // Metric cost on long signals: four scalar mse calls against one mseMany pass
+    {
+        const std::size_t total{ std::size_t(1) << 22 };
+        std::vector<double> ref(total), a(total), b(total), c(total), d(total);
+        for (std::size_t i{ 0 }; i < total; ++i) {
+            ref[i] = x_clean[i % N]; a[i] = x_noisy[i % N]; b[i] = y_sma[i % N]; c[i] = y_wma[i % N]; d[i] = y_med[i % N];
+        }
+        double scalar[4], fast[4];
+        auto t0{ std::chrono::steady_clock::now() };
+        scalar[0] = mse(ref, a); scalar[1] = mse(ref, b); scalar[2] = mse(ref, c); scalar[3] = mse(ref, d);
+        auto t1{ std::chrono::steady_clock::now() };
+        filter1d::mseMany(ref, { &a, &b, &c, &d }, fast);
+        auto t2{ std::chrono::steady_clock::now() };
+        double worst{ 0.0 };
+        for (int k{ 0 }; k < 4; ++k) worst = std::max(worst, std::abs(fast[k] - scalar[k]) / scalar[k]);
+        std::printf("MSE of 4 signals (%zu samples): mse x4: %.2f ms  mseMany: %.2f ms  (max rel. diff %.1e)\n",
+            total, std::chrono::duration<double, std::milli>(t1 - t0).count(),
+            std::chrono::duration<double, std::milli>(t2 - t1).count(), worst);
+    }
+
+    // Median cost on a long signal: sliding median of three against the switching median
+    {
+        const std::size_t total{ std::size_t(1) << 22 };
+        std::vector<double> x(total), full, sw;
+        for (std::size_t i{ 0 }; i < total; ++i) x[i] = x_noisy[i % N];
+        auto t0{ std::chrono::steady_clock::now() };
+        filter1d::median(x, full, 3);
+        auto t1{ std::chrono::steady_clock::now() };
+        const std::size_t filtered{ filter1d::switchingMedian(x, sw, 3, 0.5, -1.1, 1.1) };
+        auto t2{ std::chrono::steady_clock::now() };
+        std::printf("Median of 3 (%zu samples): median: %.2f ms  switching: %.2f ms  (%.1f%% filtered)\n",
+            total, std::chrono::duration<double, std::milli>(t1 - t0).count(),
+            std::chrono::duration<double, std::milli>(t2 - t1).count(), 100.0 * double(filtered) / double(total));
+    }
+    instrument::report(stdout);
     return 0;
 }
\ No newline at end of file
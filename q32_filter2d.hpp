@@ -0,0 +1,552 @@
+// 2D image filters on 8-bit images with mirror padding (same rule as reflect_index).
+// Images are passed as views: pointer, width, height, row stride in bytes and
+// interleaved channel count (1 for grayscale, 3 for RGB). Each channel is filtered
+// independently; views let callers filter any frame size or sub-rectangle in place
+// without copying it into a std::vector first.
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "instrument.hpp"
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace filter2d {
+
+// firstRow is the image row stored at data: a band buffer holding rows
+// [firstRow, firstRow + height) of a larger frame is addressed with frame rows.
+struct ImageView {
+    const uint8_t* data{ nullptr };
+    int width{ 0 }, height{ 0 };
+    std::ptrdiff_t stride{ 0 };   // bytes between rows
+    int channels{ 1 };
+    int firstRow{ 0 };
+    const uint8_t* row(int r) const { return data + (r - firstRow) * stride; }
+};
+
+struct MutableImageView {
+    uint8_t* data{ nullptr };
+    int width{ 0 }, height{ 0 };
+    std::ptrdiff_t stride{ 0 };
+    int channels{ 1 };
+    int firstRow{ 0 };
+    uint8_t* row(int r) const { return data + (r - firstRow) * stride; }
+    operator ImageView() const { return { data, width, height, stride, channels, firstRow }; }
+};
+
+// Views of a tightly packed buffer
+inline ImageView packedView(const uint8_t* data, int H, int W, int channels = 1) {
+    return { data, W, H, std::ptrdiff_t(W) * channels, channels };
+}
+inline MutableImageView packedView(uint8_t* data, int H, int W, int channels = 1) {
+    return { data, W, H, std::ptrdiff_t(W) * channels, channels };
+}
+
+// Mirror padding: -1 -> 1, n -> n-2
+inline int reflect(int i, int n) {
+    if (n <= 1) return 0;
+    while (i < 0 || i >= n) { i = (i < 0) ? -i : (2 * n - 2 - i); }
+    return i;
+}
+
+// [1 2 1]/4 rounded half up, identical to lround((a + 2b + c) / 4.0) for 0..255 inputs
+inline uint8_t tap121(int a, int b, int c) { return uint8_t((a + 2 * b + c + 2) >> 2); }
+
+// Columns per strip: three strip-wide rows of the horizontal pass stay in L1
+constexpr int kBlurStripWidth{ 1024 };
+
+// Horizontal [1 2 1]/4 of one row for pixel columns [c0, c1) into out (packed from c0).
+// Interleaved channels sit 'ch' bytes apart, so the interior is one flat byte loop.
+inline void blurRow121(const uint8_t* row, int W, int ch, int c0, int c1, uint8_t* out) {
+    auto border = [&](int c) {
+        for (int k{ 0 }; k < ch; ++k)
+            out[(c - c0) * ch + k] = tap121(row[reflect(c - 1, W) * ch + k], row[c * ch + k], row[reflect(c + 1, W) * ch + k]);
+        };
+    int c{ c0 };
+    for (; c < c1 && c < 1; ++c) border(c);
+    const int interiorEnd{ std::max(c, std::min(c1, W - 1)) };
+    uint8_t* o{ out + (c - c0) * ch };
+    for (int e{ c * ch }; e < interiorEnd * ch; ++e) *o++ = tap121(row[e - ch], row[e], row[e + ch]);
+    for (c = interiorEnd; c < c1; ++c) border(c);
+}
+
+// Separable 3x3 Gaussian ([1 2 1]/4 horizontally, then vertically) on output rows
+// [r0, r1) and columns [c0, c1), reading mirrored halo rows straight from src.
+// The horizontal pass of each needed row is computed once into a rolling 3-row
+// buffer (rows r-1, r, r+1 always land in distinct slots r % 3), and the vertical
+// pass reads from that buffer, so no intermediate image is stored. Integer
+// rounding after each pass makes it pixel-identical to two double-precision passes.
+// The rows live in caller-provided scratch of blur121Scratch() bytes.
+inline std::size_t blur121Scratch(int columns, int channels) {
+    return 3 * std::size_t(columns) * channels;
+}
+
+inline void blur121Region(ImageView src, MutableImageView dst, int r0, int r1, int c0, int c1, uint8_t* rows) {
+    INSTR_SCOPE("q32.blur121.region");
+    const int H{ src.height }, W{ src.width }, ch{ src.channels };
+    const int n{ (c1 - c0) * ch };
+    if (r0 >= r1 || n <= 0) return;
+    int held[3]{ -1, -1, -1 };  // image row whose horizontal pass each slot holds
+    auto row = [&](int r) {
+        uint8_t* slot{ rows + std::size_t(r % 3) * n };
+        if (held[r % 3] != r) {
+            blurRow121(src.row(r), W, ch, c0, c1, slot);
+            held[r % 3] = r;
+        }
+        return slot;
+        };
+    for (int r{ r0 }; r < r1; ++r) {
+        const uint8_t* a{ row(reflect(r - 1, H)) };
+        const uint8_t* b{ row(r) };
+        const uint8_t* c{ row(reflect(r + 1, H)) };
+        uint8_t* out{ dst.row(r) + c0 * ch };
+        for (int i{ 0 }; i < n; ++i) out[i] = tap121(a[i], b[i], c[i]);
+    }
+}
+
+inline void blur121Region(ImageView src, MutableImageView dst, int r0, int r1, int c0, int c1) {
+    if (r0 >= r1 || c0 >= c1) return;
+    std::vector<uint8_t> rows(blur121Scratch(c1 - c0, src.channels));
+    blur121Region(src, dst, r0, r1, c0, c1, rows.data());
+}
+
+// Whole image, walked in vertical strips so the three buffered rows stay in L1
+inline void blur121(ImageView src, MutableImageView dst, int stripWidth = kBlurStripWidth) {
+    for (int c0{ 0 }; c0 < src.width; c0 += stripWidth)
+        blur121Region(src, dst, 0, src.height, c0, std::min(src.width, c0 + stripWidth));
+}
+
+inline void blur121(const uint8_t* src, uint8_t* dst, int H, int W, int stripWidth = kBlurStripWidth) {
+    blur121(packedView(src, H, W), packedView(dst, H, W), stripWidth);
+}
+
+// ---------- Median ----------
+
+// Median of nine with the 19 compare-exchange network (Paeth / Devillard).
+// Only min and max are used, so V can be a scalar or a SIMD register of pixels.
+template <class V, class Min, class Max>
+inline V median9(V p0, V p1, V p2, V p3, V p4, V p5, V p6, V p7, V p8, Min mn, Max mx) {
+    auto sort2 = [&](V& a, V& b) { V lo{ mn(a, b) }; b = mx(a, b); a = lo; };
+    sort2(p1, p2); sort2(p4, p5); sort2(p7, p8);
+    sort2(p0, p1); sort2(p3, p4); sort2(p6, p7);
+    sort2(p1, p2); sort2(p4, p5); sort2(p7, p8);
+    sort2(p0, p3); sort2(p5, p8); sort2(p4, p7);
+    sort2(p3, p6); sort2(p1, p4); sort2(p2, p5);
+    sort2(p4, p7); sort2(p4, p2); sort2(p6, p4);
+    sort2(p4, p2);
+    return p4;
+}
+
+inline uint8_t median9Scalar(const uint8_t* r0, const uint8_t* r1, const uint8_t* r2, int e0, int e1, int e2) {
+    auto mn = [](uint8_t a, uint8_t b) { return a < b ? a : b; };
+    auto mx = [](uint8_t a, uint8_t b) { return a < b ? b : a; };
+    return median9<uint8_t>(r0[e0], r0[e1], r0[e2], r1[e0], r1[e1], r1[e2], r2[e0], r2[e1], r2[e2], mn, mx);
+}
+
+// 3x3 median on rows [r0, r1) and columns [c0, c1); the same value as sorting the
+// window and taking window[4]. Interior bytes run the network on 32 (AVX2) or 16
+// (SSE2) at once with unsigned byte min/max (neighbours are 'ch' bytes apart, so
+// interleaved channels need no shuffles); mirrored border columns use the scalar network.
+inline void median3x3Region(ImageView src, MutableImageView dst, int r0, int r1, int c0, int c1) {
+    INSTR_SCOPE("q32.median3x3.region");
+    const int H{ src.height }, W{ src.width }, ch{ src.channels };
+    auto border = [&](const uint8_t* p0, const uint8_t* p1, const uint8_t* p2, uint8_t* out, int c) {
+        const int cl{ reflect(c - 1, W) * ch }, cr{ reflect(c + 1, W) * ch };
+        for (int k{ 0 }; k < ch; ++k) out[c * ch + k] = median9Scalar(p0, p1, p2, cl + k, c * ch + k, cr + k);
+        };
+    for (int r{ r0 }; r < r1; ++r) {
+        const uint8_t* p0{ src.row(reflect(r - 1, H)) };
+        const uint8_t* p1{ src.row(r) };
+        const uint8_t* p2{ src.row(reflect(r + 1, H)) };
+        uint8_t* out{ dst.row(r) };
+
+        int c{ c0 };
+        for (; c < c1 && c < 1; ++c) border(p0, p1, p2, out, c);
+        const int interiorEnd{ std::max(c, std::min(c1, W - 1)) };
+        int e{ c * ch };
+        const int eEnd{ interiorEnd * ch };
+#if defined(__AVX2__)
+        auto mn256 = [](__m256i a, __m256i b) { return _mm256_min_epu8(a, b); };
+        auto mx256 = [](__m256i a, __m256i b) { return _mm256_max_epu8(a, b); };
+        for (; e + 32 <= eEnd; e += 32) {
+            auto ld = [&](const uint8_t* row, int o) { return _mm256_loadu_si256((const __m256i*)(row + e + o)); };
+            __m256i m{ median9<__m256i>(ld(p0, -ch), ld(p0, 0), ld(p0, ch), ld(p1, -ch), ld(p1, 0), ld(p1, ch),
+                ld(p2, -ch), ld(p2, 0), ld(p2, ch), mn256, mx256) };
+            _mm256_storeu_si256((__m256i*)(out + e), m);
+        }
+#endif
+#if defined(__SSE2__)
+        auto mn128 = [](__m128i a, __m128i b) { return _mm_min_epu8(a, b); };
+        auto mx128 = [](__m128i a, __m128i b) { return _mm_max_epu8(a, b); };
+        for (; e + 16 <= eEnd; e += 16) {
+            auto ld = [&](const uint8_t* row, int o) { return _mm_loadu_si128((const __m128i*)(row + e + o)); };
+            __m128i m{ median9<__m128i>(ld(p0, -ch), ld(p0, 0), ld(p0, ch), ld(p1, -ch), ld(p1, 0), ld(p1, ch),
+                ld(p2, -ch), ld(p2, 0), ld(p2, ch), mn128, mx128) };
+            _mm_storeu_si128((__m128i*)(out + e), m);
+        }
+#endif
+        for (; e < eEnd; ++e) out[e] = median9Scalar(p0, p1, p2, e - ch, e, e + ch);
+        for (c = interiorEnd; c < c1; ++c) border(p0, p1, p2, out, c);
+    }
+}
+
+inline void median3x3(ImageView src, MutableImageView dst) {
+    median3x3Region(src, dst, 0, src.height, 0, src.width);
+}
+
+inline void median3x3(const uint8_t* src, uint8_t* dst, int H, int W) {
+    median3x3(packedView(src, H, W), packedView(dst, H, W));
+}
+
+// ---------- Switching median ----------
+
+// Impulse test of the switching median: a sample is an impulse candidate when it is
+// an extreme (0 or 255) or lies at least `threshold` beyond the range of its eight
+// neighbours. Salt and pepper lands on the extremes; clean samples, Gaussian noise
+// included, stay within reach of their neighbourhood and are left untouched.
+constexpr int kImpulseThreshold{ 40 };
+
+inline bool isImpulse(uint8_t p, uint8_t lo, uint8_t hi, int threshold) {
+    return p <= std::max(0, lo - threshold) || p >= std::min(255, hi + threshold);
+}
+
+// Switching 3x3 median on rows [r0, r1) and columns [c0, c1): samples flagged by
+// isImpulse get the median of their window, all others are copied unchanged. The
+// test runs on 32 (AVX2) or 16 (SSE2) bytes at once from the neighbour min and max
+// (saturating arithmetic covers the clamping); a block without candidates is
+// stored as is, and only blocks with one run the median network, blended in on
+// the flagged bytes. Mirrored border columns use the scalar test.
+inline void switchingMedian3x3Region(ImageView src, MutableImageView dst, int r0, int r1, int c0, int c1,
+    int threshold = kImpulseThreshold) {
+    INSTR_SCOPE("q32.switching_median3x3.region");
+    const int H{ src.height }, W{ src.width }, ch{ src.channels };
+    threshold = std::clamp(threshold, 0, 255);
+    auto filterOne = [&](const uint8_t* p0, const uint8_t* p1, const uint8_t* p2, int e0, int e1, int e2, uint8_t* out) {
+        const uint8_t nb[8]{ p0[e0], p0[e1], p0[e2], p1[e0], p1[e2], p2[e0], p2[e1], p2[e2] };
+        const uint8_t lo{ *std::min_element(nb, nb + 8) }, hi{ *std::max_element(nb, nb + 8) };
+        out[e1] = isImpulse(p1[e1], lo, hi, threshold) ? median9Scalar(p0, p1, p2, e0, e1, e2) : p1[e1];
+        };
+    auto border = [&](const uint8_t* p0, const uint8_t* p1, const uint8_t* p2, uint8_t* out, int c) {
+        const int cl{ reflect(c - 1, W) * ch }, cr{ reflect(c + 1, W) * ch };
+        for (int k{ 0 }; k < ch; ++k) filterOne(p0, p1, p2, cl + k, c * ch + k, cr + k, out);
+        };
+    for (int r{ r0 }; r < r1; ++r) {
+        const uint8_t* p0{ src.row(reflect(r - 1, H)) };
+        const uint8_t* p1{ src.row(r) };
+        const uint8_t* p2{ src.row(reflect(r + 1, H)) };
+        uint8_t* out{ dst.row(r) };
+
+        int c{ c0 };
+        for (; c < c1 && c < 1; ++c) border(p0, p1, p2, out, c);
+        const int interiorEnd{ std::max(c, std::min(c1, W - 1)) };
+        int e{ c * ch };
+        const int eEnd{ interiorEnd * ch };
+#if defined(__AVX2__)
+        auto mn256 = [](__m256i a, __m256i b) { return _mm256_min_epu8(a, b); };
+        auto mx256 = [](__m256i a, __m256i b) { return _mm256_max_epu8(a, b); };
+        const __m256i t256{ _mm256_set1_epi8(char(threshold)) }, zero256{ _mm256_setzero_si256() };
+        for (; e + 32 <= eEnd; e += 32) {
+            auto ld = [&](const uint8_t* row, int o) { return _mm256_loadu_si256((const __m256i*)(row + e + o)); };
+            const __m256i v0{ ld(p0, -ch) }, v1{ ld(p0, 0) }, v2{ ld(p0, ch) }, v3{ ld(p1, -ch) }, v4{ ld(p1, 0) };
+            const __m256i v5{ ld(p1, ch) }, v6{ ld(p2, -ch) }, v7{ ld(p2, 0) }, v8{ ld(p2, ch) };
+            const __m256i lo{ mn256(mn256(mn256(v0, v1), mn256(v2, v3)), mn256(mn256(v5, v6), mn256(v7, v8))) };
+            const __m256i hi{ mx256(mx256(mx256(v0, v1), mx256(v2, v3)), mx256(mx256(v5, v6), mx256(v7, v8))) };
+            const __m256i flag{ _mm256_or_si256(
+                _mm256_cmpeq_epi8(_mm256_subs_epu8(v4, _mm256_subs_epu8(lo, t256)), zero256),
+                _mm256_cmpeq_epi8(_mm256_subs_epu8(_mm256_adds_epu8(hi, t256), v4), zero256)) };
+            if (_mm256_testz_si256(flag, flag)) {
+                _mm256_storeu_si256((__m256i*)(out + e), v4);
+                continue;
+            }
+            const __m256i m{ median9<__m256i>(v0, v1, v2, v3, v4, v5, v6, v7, v8, mn256, mx256) };
+            _mm256_storeu_si256((__m256i*)(out + e), _mm256_blendv_epi8(v4, m, flag));
+        }
+#endif
+#if defined(__SSE2__)
+        auto mn128 = [](__m128i a, __m128i b) { return _mm_min_epu8(a, b); };
+        auto mx128 = [](__m128i a, __m128i b) { return _mm_max_epu8(a, b); };
+        const __m128i t128{ _mm_set1_epi8(char(threshold)) }, zero128{ _mm_setzero_si128() };
+        for (; e + 16 <= eEnd; e += 16) {
+            auto ld = [&](const uint8_t* row, int o) { return _mm_loadu_si128((const __m128i*)(row + e + o)); };
+            const __m128i v0{ ld(p0, -ch) }, v1{ ld(p0, 0) }, v2{ ld(p0, ch) }, v3{ ld(p1, -ch) }, v4{ ld(p1, 0) };
+            const __m128i v5{ ld(p1, ch) }, v6{ ld(p2, -ch) }, v7{ ld(p2, 0) }, v8{ ld(p2, ch) };
+            const __m128i lo{ mn128(mn128(mn128(v0, v1), mn128(v2, v3)), mn128(mn128(v5, v6), mn128(v7, v8))) };
+            const __m128i hi{ mx128(mx128(mx128(v0, v1), mx128(v2, v3)), mx128(mx128(v5, v6), mx128(v7, v8))) };
+            const __m128i flag{ _mm_or_si128(
+                _mm_cmpeq_epi8(_mm_subs_epu8(v4, _mm_subs_epu8(lo, t128)), zero128),
+                _mm_cmpeq_epi8(_mm_subs_epu8(_mm_adds_epu8(hi, t128), v4), zero128)) };
+            if (_mm_movemask_epi8(flag) == 0) {
+                _mm_storeu_si128((__m128i*)(out + e), v4);
+                continue;
+            }
+            const __m128i m{ median9<__m128i>(v0, v1, v2, v3, v4, v5, v6, v7, v8, mn128, mx128) };
+            _mm_storeu_si128((__m128i*)(out + e), _mm_or_si128(_mm_and_si128(flag, m), _mm_andnot_si128(flag, v4)));
+        }
+#endif
+        for (; e < eEnd; ++e) filterOne(p0, p1, p2, e - ch, e, e + ch, out);
+        for (c = interiorEnd; c < c1; ++c) border(p0, p1, p2, out, c);
+    }
+}
+
+inline void switchingMedian3x3(ImageView src, MutableImageView dst, int threshold = kImpulseThreshold) {
+    switchingMedian3x3Region(src, dst, 0, src.height, 0, src.width, threshold);
+}
+
+inline void switchingMedian3x3(const uint8_t* src, uint8_t* dst, int H, int W, int threshold = kImpulseThreshold) {
+    switchingMedian3x3(packedView(src, H, W), packedView(dst, H, W), threshold);
+}
+
+// (2R+1)x(2R+1) median on rows [r0, r1) and columns [c0, c1) in constant time per
+// pixel (Perreault & Hebert 2007), one channel at a time. Every column the kernel
+// touches, c0 - R to c1 + R - 1 (mirrored into the image), keeps a histogram of its
+// 2R+1 window rows, updated with one removal and one insertion per row; the kernel
+// histogram slides along the row. Only its 16-bin coarse histogram is updated at
+// every pixel; each 16-bin block of the fine histogram is brought up to date only
+// when the median search lands in it, from the columns passed since its last use
+// or, if that is more work, rebuilt from the 2R+1 window columns.
+// The histograms live in caller-provided scratch of medianHistogramScratch() entries.
+// Bins are 16-bit, which holds the (2R+1)^2 window count up to R = kMaxMedianRadius.
+// Radii outside 1..kMaxMedianRadius throw std::invalid_argument.
+constexpr int kMaxMedianRadius{ 127 };
+
+inline void checkMedianRadius(int radius, int lowest, const char* message) {
+    if (radius < lowest || radius > kMaxMedianRadius) throw std::invalid_argument(message);
+}
+
+inline std::size_t medianHistogramScratch(int radius, int columns) {
+    return std::size_t(columns + 2 * radius) * (256 + 16);
+}
+
+inline void medianHistogramRegion(ImageView src, MutableImageView dst, int radius, int r0, int r1, int c0, int c1,
+    uint16_t* scratch) {
+    checkMedianRadius(radius, 1, "medianHistogram: radius must be in 1..kMaxMedianRadius");
+    if (r0 >= r1 || c0 >= c1) return;
+    INSTR_SCOPE("q32.median_histogram.region");
+    const int H{ src.height }, W{ src.width }, ch{ src.channels };
+    const int k{ 2 * radius + 1 };
+    const int half{ (k * k) / 2 + 1 };   // rank of the median, 1-based
+    const int v0{ c0 - radius }, nv{ c1 - c0 + 2 * radius };
+    uint16_t* cols{ scratch };
+    uint16_t* colsCoarse{ scratch + std::size_t(nv) * 256 };
+    auto col = [&](int v) { return cols + std::size_t(v - v0) * 256; };
+    auto colCoarse = [&](int v) { return colsCoarse + std::size_t(v - v0) * 16; };
+
+    for (int chan{ 0 }; chan < ch; ++chan) {
+        std::fill(scratch, scratch + medianHistogramScratch(radius, c1 - c0), uint16_t(0));
+        auto addRow = [&](int r, int d) {
+            const uint8_t* row{ src.row(reflect(r, H)) + chan };
+            for (int v{ v0 }; v < v0 + nv; ++v) {
+                uint8_t px{ row[reflect(v, W) * ch] };
+                col(v)[px] = uint16_t(col(v)[px] + d);
+                colCoarse(v)[px >> 4] = uint16_t(colCoarse(v)[px >> 4] + d);
+            }
+            };
+
+        for (int o{ -radius }; o <= radius; ++o) addRow(r0 + o, 1);
+
+        uint16_t fine[256], coarse[16];
+        int synced[16];   // column whose window fine block b holds
+        for (int r{ r0 }; r < r1; ++r) {
+            if (r > r0) { addRow(r - radius - 1, -1); addRow(r + radius, 1); }
+
+            std::fill(coarse, coarse + 16, uint16_t(0));
+            for (int v{ c0 - radius }; v <= c0 + radius; ++v) {
+                const uint16_t* hc{ colCoarse(v) };
+                for (int b{ 0 }; b < 16; ++b) coarse[b] += hc[b];
+            }
+            std::fill(synced, synced + 16, c0 - k);   // stale: rebuilt on first use
+
+            uint8_t* out{ dst.row(r) + chan };
+            for (int c{ c0 }; c < c1; ++c) {
+                if (c > c0) {
+                    const uint16_t* hcl{ colCoarse(c - radius - 1) };
+                    const uint16_t* hce{ colCoarse(c + radius) };
+                    for (int b{ 0 }; b < 16; ++b) coarse[b] = uint16_t(coarse[b] + hce[b] - hcl[b]);
+                }
+                int seen{ 0 };
+                int b{ 0 };
+                while (seen + coarse[b] < half) seen += coarse[b++];
+
+                uint16_t* block{ fine + 16 * b };
+                if (synced[b] != c) {
+                    if (2 * (c - synced[b]) >= k) {
+                        std::fill(block, block + 16, uint16_t(0));
+                        for (int v{ c - radius }; v <= c + radius; ++v) {
+                            const uint16_t* h{ col(v) + 16 * b };
+                            for (int i{ 0 }; i < 16; ++i) block[i] = uint16_t(block[i] + h[i]);
+                        }
+                    }
+                    else {
+                        for (int x{ synced[b] + 1 }; x <= c; ++x) {
+                            const uint16_t* hl{ col(x - radius - 1) + 16 * b };
+                            const uint16_t* he{ col(x + radius) + 16 * b };
+                            for (int i{ 0 }; i < 16; ++i) block[i] = uint16_t(block[i] + he[i] - hl[i]);
+                        }
+                    }
+                    synced[b] = c;
+                }
+                int v{ 0 };
+                while (seen + block[v] < half) seen += block[v++];
+                out[c * ch] = uint8_t(16 * b + v);
+            }
+        }
+    }
+}
+
+inline void medianHistogramRegion(ImageView src, MutableImageView dst, int radius, int r0, int r1, int c0, int c1) {
+    checkMedianRadius(radius, 1, "medianHistogram: radius must be in 1..kMaxMedianRadius");
+    if (r0 >= r1 || c0 >= c1) return;
+    std::vector<uint16_t> scratch(medianHistogramScratch(radius, c1 - c0));
+    medianHistogramRegion(src, dst, radius, r0, r1, c0, c1, scratch.data());
+}
+
+inline void medianHistogram(ImageView src, MutableImageView dst, int radius) {
+    medianHistogramRegion(src, dst, radius, 0, src.height, 0, src.width);
+}
+
+inline void medianHistogram(const uint8_t* src, uint8_t* dst, int H, int W, int radius) {
+    medianHistogram(packedView(src, H, W), packedView(dst, H, W), radius);
+}
+
+// Square median of the given radius (0 to kMaxMedianRadius, else std::invalid_argument):
+// a plain copy for 0, the sorting network for 3x3, histograms above
+inline void median(ImageView src, MutableImageView dst, int radius) {
+    checkMedianRadius(radius, 0, "median: radius must be in 0..kMaxMedianRadius");
+    if (radius == 0) {
+        if (src.data == dst.data) return;
+        for (int r{ 0 }; r < src.height; ++r) std::memcpy(dst.row(r), src.row(r), std::size_t(src.width) * src.channels);
+    }
+    else if (radius == 1) median3x3(src, dst);
+    else medianHistogram(src, dst, radius);
+}
+
+// ---------- Multi-core tiled execution ----------
+
+struct Tiling {
+    int threads{ 0 };      // 0: every hardware thread
+    int tileH{ 128 };
+    int tileW{ 1024 };
+};
+
+// Runs fn(r0, r1, c0, c1) over every tile of an H x W image on a work-stealing pool.
+// Each worker starts with a contiguous run of tiles (row-major, for locality) and
+// takes from the front of its own queue; an idle worker steals the back half of
+// the fullest queue. Tiles write disjoint output and read only the shared input,
+// so the result does not depend on the thread count or on who ran which tile.
+template <class F>
+void forEachTile(int H, int W, const Tiling& tiling, F&& fn) {
+    if (H <= 0 || W <= 0) return;
+    const int th{ std::max(1, tiling.tileH) }, tw{ std::max(1, tiling.tileW) };
+    const int tilesY{ (H + th - 1) / th }, tilesX{ (W + tw - 1) / tw }, tiles{ tilesY * tilesX };
+    int threads{ tiling.threads > 0 ? tiling.threads : int(std::max(1u, std::thread::hardware_concurrency())) };
+    threads = std::min(threads, tiles);
+
+    auto runTile = [&](int t) {
+        const int ty{ t / tilesX }, tx{ t % tilesX };
+        fn(ty * th, std::min(H, ty * th + th), tx * tw, std::min(W, tx * tw + tw));
+        };
+    if (threads <= 1) {
+        for (int t{ 0 }; t < tiles; ++t) runTile(t);
+        return;
+    }
+
+    struct Queue { std::mutex m; int begin{ 0 }, end{ 0 }; };
+    std::vector<Queue> queues(threads);
+    for (int w{ 0 }; w < threads; ++w) {
+        queues[w].begin = int(std::int64_t(tiles) * w / threads);
+        queues[w].end = int(std::int64_t(tiles) * (w + 1) / threads);
+    }
+
+    auto worker = [&](int self) {
+        for (;;) {
+            int t{ -1 };
+            {
+                std::lock_guard<std::mutex> lock{ queues[self].m };
+                if (queues[self].begin < queues[self].end) t = queues[self].begin++;
+            }
+            if (t < 0) {
+                // Steal the back half of the fullest queue
+                int victim{ -1 }, most{ 0 };
+                for (int w{ 0 }; w < threads; ++w) {
+                    if (w == self) continue;
+                    std::lock_guard<std::mutex> lock{ queues[w].m };
+                    if (queues[w].end - queues[w].begin > most) { most = queues[w].end - queues[w].begin; victim = w; }
+                }
+                if (victim < 0) return;
+                int from{ 0 }, to{ 0 };
+                {
+                    std::lock_guard<std::mutex> lock{ queues[victim].m };
+                    const int left{ queues[victim].end - queues[victim].begin };
+                    if (left <= 0) continue;
+                    to = queues[victim].end;
+                    from = to - (left + 1) / 2;
+                    queues[victim].end = from;
+                }
+                std::lock_guard<std::mutex> lock{ queues[self].m };
+                queues[self].begin = from + 1;
+                queues[self].end = to;
+                t = from;
+            }
+            runTile(t);
+        }
+        };
+
+    std::vector<std::thread> pool;
+    for (int w{ 1 }; w < threads; ++w) pool.emplace_back(worker, w);
+    worker(0);
+    for (std::thread& t : pool) t.join();
+}
+
+inline void blur121Tiled(ImageView src, MutableImageView dst, const Tiling& tiling = {}) {
+    forEachTile(src.height, src.width, tiling, [&](int r0, int r1, int c0, int c1) {
+        blur121Region(src, dst, r0, r1, c0, c1);
+        });
+}
+
+inline void median3x3Tiled(ImageView src, MutableImageView dst, const Tiling& tiling = {}) {
+    forEachTile(src.height, src.width, tiling, [&](int r0, int r1, int c0, int c1) {
+        median3x3Region(src, dst, r0, r1, c0, c1);
+        });
+}
+
+inline void switchingMedian3x3Tiled(ImageView src, MutableImageView dst, int threshold = kImpulseThreshold, const Tiling& tiling = {}) {
+    forEachTile(src.height, src.width, tiling, [&](int r0, int r1, int c0, int c1) {
+        switchingMedian3x3Region(src, dst, r0, r1, c0, c1, threshold);
+        });
+}
+
+inline void medianHistogramTiled(ImageView src, MutableImageView dst, int radius, const Tiling& tiling = {}) {
+    checkMedianRadius(radius, 1, "medianHistogramTiled: radius must be in 1..kMaxMedianRadius");
+    forEachTile(src.height, src.width, tiling, [&](int r0, int r1, int c0, int c1) {
+        medianHistogramRegion(src, dst, radius, r0, r1, c0, c1);
+        });
+}
+
+inline void blur121Tiled(const uint8_t* src, uint8_t* dst, int H, int W, const Tiling& tiling = {}) {
+    blur121Tiled(packedView(src, H, W), packedView(dst, H, W), tiling);
+}
+
+inline void median3x3Tiled(const uint8_t* src, uint8_t* dst, int H, int W, const Tiling& tiling = {}) {
+    median3x3Tiled(packedView(src, H, W), packedView(dst, H, W), tiling);
+}
+
+inline void switchingMedian3x3Tiled(const uint8_t* src, uint8_t* dst, int H, int W, int threshold = kImpulseThreshold,
+    const Tiling& tiling = {}) {
+    switchingMedian3x3Tiled(packedView(src, H, W), packedView(dst, H, W), threshold, tiling);
+}
+
+inline void medianHistogramTiled(const uint8_t* src, uint8_t* dst, int H, int W, int radius, const Tiling& tiling = {}) {
+    medianHistogramTiled(packedView(src, H, W), packedView(dst, H, W), radius, tiling);
+}
+
+} // namespace filter2d
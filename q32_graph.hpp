@@ -0,0 +1,439 @@
+// Filter graph for the 2D denoise chain. Stages (noise, blur, medians) and their
+// consumers (PSNR metrics, full-frame sinks) are declared as nodes; the graph plans
+// the run once per frame shape and then executes it without heap allocation:
+//  - a point stage (noise) writes in place when its input frame is not read after
+//    it, and is fused into the pass of the stage before it when it is that stage's
+//    only reader;
+//  - a stage read only by metrics is never stored: each row band is computed into
+//    a per-worker band buffer and scored while it is still in cache;
+//  - every other stage gets a frame buffer, handed on to a later stage once the
+//    last reader of the frame has run.
+// Frames, band buffers and partial sums are carved from one arena and the workers
+// are started once, so only the first run of a new frame shape allocates.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "q32_filter2d.hpp"
+#include "q32_metrics.hpp"
+#include "noise.hpp"
+#include "instrument.hpp"
+
+namespace filter2d {
+
+// Bump allocator over one block. The block only grows, so a plan that fits the
+// previous one reuses it as is.
+class Arena {
+public:
+    // Drops every allocation and makes room for at least `bytes`
+    void reset(std::size_t bytes) {
+        if (bytes > capacity_) {
+            block_.reset(new uint8_t[bytes + kAlign]);
+            capacity_ = bytes;
+            ++growths_;
+        }
+        used_ = 0;
+    }
+
+    // Cache-line aligned; the total must fit the size given to reset()
+    uint8_t* allocate(std::size_t bytes) {
+        uint8_t* base{ block_.get() + (kAlign - reinterpret_cast<std::uintptr_t>(block_.get()) % kAlign) % kAlign };
+        uint8_t* p{ base + used_ };
+        used_ += roundUp(bytes);
+        assert(used_ <= capacity_);
+        return p;
+    }
+
+    static std::size_t roundUp(std::size_t bytes) { return (bytes + kAlign - 1) / kAlign * kAlign; }
+    std::size_t capacity() const { return capacity_; }
+    int growths() const { return growths_; }
+
+private:
+    static constexpr std::size_t kAlign{ 64 };
+    std::unique_ptr<uint8_t[]> block_;
+    std::size_t capacity_{ 0 }, used_{ 0 };
+    int growths_{ 0 };
+};
+
+// Workers started once and parked between jobs, so a job costs no thread start-up
+// and no allocation
+class WorkerPool {
+public:
+    explicit WorkerPool(int threads = 0) {
+        if (threads <= 0) threads = int(std::max(1u, std::thread::hardware_concurrency()));
+        for (int w{ 1 }; w < threads; ++w) workers_.emplace_back([this, w] { loop(w); });
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock{ m_ };
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (std::thread& t : workers_) t.join();
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    int size() const { return int(workers_.size()) + 1; }
+
+    // Calls fn(task, worker) for every task in [0, tasks) and returns once all are
+    // done; worker in [0, size()) names the calling thread (the caller is worker 0)
+    template <class F>
+    void run(int tasks, F& fn) {
+        {
+            std::lock_guard<std::mutex> lock{ m_ };
+            job_ = &fn;
+            call_ = [](void* f, int task, int worker) { (*static_cast<F*>(f))(task, worker); };
+            tasks_ = tasks;
+            next_.store(0);
+            busy_ = int(workers_.size());
+            ++generation_;
+        }
+        wake_.notify_all();
+        work(0);
+        std::unique_lock<std::mutex> lock{ m_ };
+        done_.wait(lock, [&] { return busy_ == 0; });
+    }
+
+private:
+    void work(int worker) {
+        for (int t; (t = next_.fetch_add(1)) < tasks_;) call_(job_, t, worker);
+    }
+
+    void loop(int worker) {
+        std::uint64_t seen{ 0 };
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock{ m_ };
+                wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+                if (stop_) return;
+                seen = generation_;
+            }
+            work(worker);
+            std::lock_guard<std::mutex> lock{ m_ };
+            if (--busy_ == 0) done_.notify_one();
+        }
+    }
+
+    std::mutex m_;
+    std::condition_variable wake_, done_;
+    void* job_{ nullptr };
+    void (*call_)(void*, int, int) { nullptr };
+    int tasks_{ 0 };
+    std::atomic<int> next_{ 0 };
+    int busy_{ 0 };
+    std::uint64_t generation_{ 0 };
+    bool stop_{ false };
+    std::vector<std::thread> workers_;
+};
+
+// Usage:
+//   FilterGraph g;
+//   auto gt{ g.input() };
+//   auto noisy{ g.noise(gt, {}, seed) };
+//   g.psnr(gt, g.median(noisy, 1), &db);      // median never stored, scored per band
+//   g.sink(noisy, [](ImageView v) { ... });   // noisy stored, shown to the sink
+//   g.run({ frame });
+// Results match the full-frame calls (addImageNoise, blur121, median, psnr) exactly.
+class FilterGraph {
+public:
+    using Node = int;
+
+    explicit FilterGraph(int threads = 0, int bandRows = 32) : pool_{ threads }, bandRows_{ std::max(1, bandRows) } {}
+
+    // Frames passed to run(), in declaration order
+    Node input() { ++inputs_; return add({ Op::Input }); }
+
+    Node noise(Node in, const noise::ImageNoise& params, std::uint64_t seed) {
+        NodeDef d{ Op::Noise, in };
+        d.params = params;
+        d.seed = seed;
+        return add(d);
+    }
+
+    Node blur121(Node in) { return add({ Op::Blur, in }); }
+
+    // Square median: the sorting network for radius 1, histograms above (up to
+    // kMaxMedianRadius, else std::invalid_argument)
+    Node median(Node in, int radius) {
+        checkMedianRadius(radius, 1, "FilterGraph::median: radius must be in 1..kMaxMedianRadius");
+        NodeDef d{ Op::Median, in };
+        d.radius = radius;
+        return add(d);
+    }
+
+    // 3x3 median on impulse candidates only (switchingMedian3x3)
+    Node switchingMedian(Node in, int threshold = kImpulseThreshold) {
+        NodeDef d{ Op::SwitchingMedian, in };
+        d.radius = threshold;
+        return add(d);
+    }
+
+    // *out receives the PSNR of test against ref. ref must be an input or a node
+    // declared before test's chain.
+    void psnr(Node ref, Node test, double* out) {
+        metrics_.push_back({ ref, test, out, nullptr });
+        planned_ = false;
+    }
+
+    // fn sees the full frame of node once it is computed; the view is only valid
+    // during the call
+    void sink(Node node, std::function<void(ImageView)> fn) {
+        sinks_.push_back({ node, std::move(fn) });
+        planned_ = false;
+    }
+
+    // Runs the graph on one frame per input (same size and channel count)
+    void run(std::initializer_list<ImageView> inputs) {
+        INSTR_SCOPE("q32.graph.run");
+        assert(int(inputs.size()) == inputs_);
+        const ImageView* bound{ inputs.begin() };
+        for (NodeDef& d : nodes_) {
+            if (d.op == Op::Input) d.view = *bound++;
+        }
+        const ImageView& first{ *inputs.begin() };
+        if (!planned_ || first.width != W_ || first.height != H_ || first.channels != C_) {
+            prepare(first.width, first.height, first.channels);
+        }
+        for (std::size_t p{ 0 }; p < passes_.size(); ++p) runPass(int(p));
+    }
+
+    // Plan of the last run
+    int frameBuffers() const { return slots_; }
+    int bandRows() const { return bandRows_; }
+    std::size_t arenaBytes() const { return arena_.capacity(); }
+    int arenaGrowths() const { return arena_.growths(); }
+
+private:
+    enum class Op { Input, Noise, Blur, Median, SwitchingMedian };
+
+    struct NodeDef {
+        Op op;
+        Node in{ -1 };
+        int radius{ 0 };        // median radius, or the impulse threshold
+        noise::ImageNoise params{};
+        std::uint64_t seed{ 0 };
+        // Plan
+        int readers{ 0 };       // stages and sinks reading the full frame
+        bool metricRef{ false };
+        int pass{ -1 };
+        int lastPass{ -1 };     // last pass reading the frame
+        int slot{ -1 };         // frame buffer, -1: band buffers only
+        ImageView view{};       // bound input
+    };
+
+    struct Metric {
+        Node ref, test;
+        double* out;
+        std::uint64_t* partial;   // one sum per band
+    };
+
+    struct Sink {
+        Node node;
+        std::function<void(ImageView)> fn;
+    };
+
+    struct Pass {
+        std::vector<Node> stages;   // the first reads a full frame, the rest are fused point stages
+        int slot{ -1 };
+    };
+
+    Node add(const NodeDef& d) {
+        assert(d.op == Op::Input || (d.in >= 0 && d.in < int(nodes_.size())));
+        nodes_.push_back(d);
+        planned_ = false;
+        return Node(nodes_.size() - 1);
+    }
+
+    void prepare(int W, int H, int C) {
+        W_ = W; H_ = H; C_ = C;
+        for (NodeDef& d : nodes_) { d.readers = 0; d.metricRef = false; d.pass = -1; d.lastPass = -1; d.slot = -1; }
+        for (const NodeDef& d : nodes_) {
+            if (d.in >= 0) ++nodes_[d.in].readers;
+        }
+        for (const Sink& s : sinks_) ++nodes_[s.node].readers;
+        for (const Metric& m : metrics_) nodes_[m.ref].metricRef = true;
+        // Chains: a point stage joins the pass of its input when nothing else needs
+        // that input as a frame
+        passes_.clear();
+        for (Node n{ 0 }; n < Node(nodes_.size()); ++n) {
+            NodeDef& d{ nodes_[n] };
+            if (d.op == Op::Input) {
+                if (!scored(n) && !hasSink(n)) continue;
+            }
+            else if (d.op == Op::Noise && nodes_[d.in].op != Op::Input && nodes_[d.in].readers == 1 && !nodes_[d.in].metricRef &&
+                passes_[nodes_[d.in].pass].stages.back() == d.in && !hasSink(d.in)) {
+                d.pass = nodes_[d.in].pass;
+                passes_[d.pass].stages.push_back(n);
+                continue;
+            }
+            d.pass = int(passes_.size());
+            passes_.push_back({ { n } });
+        }
+
+        // Frame lifetimes in passes
+        for (NodeDef& d : nodes_) d.lastPass = d.pass;
+        for (const NodeDef& d : nodes_) {
+            if (d.in >= 0) nodes_[d.in].lastPass = std::max(nodes_[d.in].lastPass, d.pass);
+        }
+        for (const Metric& m : metrics_) {
+            assert(nodes_[m.ref].op == Op::Input || nodes_[m.ref].pass < nodes_[m.test].pass);
+            nodes_[m.ref].lastPass = std::max(nodes_[m.ref].lastPass, nodes_[m.test].pass);
+        }
+
+        // Frame buffers: in place when the input frame dies in this pass, otherwise
+        // the lowest free buffer, released after the last pass reading it
+        slots_ = 0;
+        std::vector<int> free;
+        for (int p{ 0 }; p < int(passes_.size()); ++p) {
+            Pass& pass{ passes_[p] };
+            NodeDef& head{ nodes_[pass.stages.front()] };
+            NodeDef& tail{ nodes_[pass.stages.back()] };
+            const bool stored{ tail.readers > 0 || tail.metricRef };
+            if (head.op == Op::Noise && nodes_[head.in].slot >= 0 && nodes_[head.in].lastPass == p && !nodes_[head.in].metricRef) {
+                pass.slot = nodes_[head.in].slot;
+                nodes_[head.in].slot = -1;
+            }
+            else if (stored && head.op != Op::Input) {
+                if (free.empty()) pass.slot = slots_++;
+                else { pass.slot = free.back(); free.pop_back(); }
+            }
+            tail.slot = pass.slot;
+            for (NodeDef& d : nodes_) {
+                if (d.slot >= 0 && d.lastPass == p) { free.push_back(d.slot); d.slot = -1; d.lastPass = -1; }
+            }
+            std::sort(free.begin(), free.end(), std::greater<int>());
+        }
+        // Restore the slots the pass loop released, for run()
+        for (Pass& pass : passes_) nodes_[pass.stages.back()].slot = pass.slot;
+
+        // Arena: frames, then one band buffer and kernel scratch per worker,
+        // then the per-band metric sums
+        const std::size_t frameBytes{ std::size_t(W) * H * C };
+        const std::size_t bandBytes{ std::size_t(bandRows_) * W * C };
+        std::size_t scratchBytes{ 0 };
+        for (const NodeDef& d : nodes_) {
+            if (d.op == Op::Blur) scratchBytes = std::max(scratchBytes, blur121Scratch(W, C));
+            if (d.op == Op::Median && d.radius > 1) scratchBytes = std::max(scratchBytes, medianHistogramScratch(d.radius, W) * sizeof(uint16_t));
+        }
+        bands_ = (H + bandRows_ - 1) / bandRows_;
+        const int workers{ pool_.size() };
+        arena_.reset(slots_ * Arena::roundUp(frameBytes) + workers * (Arena::roundUp(bandBytes) + Arena::roundUp(scratchBytes)) +
+            metrics_.size() * Arena::roundUp(std::size_t(bands_) * sizeof(std::uint64_t)));
+        frames_.resize(slots_);
+        for (uint8_t*& f : frames_) f = arena_.allocate(frameBytes);
+        bandBuffers_.resize(workers);
+        scratch_.resize(workers);
+        for (int w{ 0 }; w < workers; ++w) {
+            bandBuffers_[w] = arena_.allocate(bandBytes);
+            scratch_[w] = arena_.allocate(scratchBytes);
+        }
+        for (Metric& m : metrics_) m.partial = reinterpret_cast<std::uint64_t*>(arena_.allocate(std::size_t(bands_) * sizeof(std::uint64_t)));
+        planned_ = true;
+    }
+
+    bool scored(Node n) const {
+        return std::any_of(metrics_.begin(), metrics_.end(), [&](const Metric& m) { return m.test == n; });
+    }
+
+    bool hasSink(Node n) const {
+        return std::any_of(sinks_.begin(), sinks_.end(), [&](const Sink& s) { return s.node == n; });
+    }
+
+    MutableImageView frame(int slot) const { return packedView(frames_[slot], H_, W_, C_); }
+
+    ImageView viewOf(Node n) const {
+        const NodeDef& d{ nodes_[n] };
+        if (d.op == Op::Input) return d.view;
+        assert(d.slot >= 0);
+        return frame(d.slot);
+    }
+
+    void runPass(int p) {
+        const Pass& pass{ passes_[p] };
+        const std::size_t rowBytes{ std::size_t(W_) * C_ };
+        auto band = [&](int b, int worker) {
+            const int r0{ b * bandRows_ }, r1{ std::min(H_, r0 + bandRows_) };
+            const MutableImageView target{ pass.slot >= 0 ? frame(pass.slot) :
+                MutableImageView{ bandBuffers_[worker], W_, r1 - r0, std::ptrdiff_t(rowBytes), C_, r0 } };
+            for (Node s : pass.stages) {
+                const NodeDef& d{ nodes_[s] };
+                ImageView out = target;
+                switch (d.op) {
+                case Op::Input:
+                    out = d.view;
+                    break;
+                case Op::Noise: {
+                    const ImageView src{ s == pass.stages.front() ? viewOf(d.in) : ImageView(target) };
+                    for (int r{ r0 }; r < r1; ++r) {
+                        if (src.row(r) != target.row(r)) std::memcpy(target.row(r), src.row(r), rowBytes);
+                        noise::addImageNoiseRange(target.row(r), rowBytes, d.params, d.seed, std::uint64_t(r) * rowBytes);
+                    }
+                    break;
+                }
+                case Op::Blur:
+                    blur121Region(viewOf(d.in), target, r0, r1, 0, W_, scratch_[worker]);
+                    break;
+                case Op::Median:
+                    if (d.radius <= 1) median3x3Region(viewOf(d.in), target, r0, r1, 0, W_);
+                    else medianHistogramRegion(viewOf(d.in), target, d.radius, r0, r1, 0, W_, reinterpret_cast<uint16_t*>(scratch_[worker]));
+                    break;
+                case Op::SwitchingMedian:
+                    switchingMedian3x3Region(viewOf(d.in), target, r0, r1, 0, W_, d.radius);
+                    break;
+                }
+                for (const Metric& m : metrics_) {
+                    if (m.test != s) continue;
+                    const ImageView ref{ viewOf(m.ref) };
+                    std::uint64_t sse{ 0 };
+                    for (int r{ r0 }; r < r1; ++r) sse += sumSquaredDiff(ref.row(r), out.row(r), rowBytes);
+                    m.partial[b] = sse;
+                }
+            }
+            };
+        if (nodes_[pass.stages.front()].op != Op::Input || scored(pass.stages.front())) pool_.run(bands_, band);
+
+        for (Node s : pass.stages) {
+            for (const Metric& m : metrics_) {
+                if (m.test != s) continue;
+                std::uint64_t sse{ 0 };
+                for (int b{ 0 }; b < bands_; ++b) sse += m.partial[b];
+                *m.out = psnrFromSse(sse, std::uint64_t(rowBytes) * H_);
+            }
+        }
+        for (const Sink& s : sinks_) {
+            if (nodes_[s.node].pass == p) s.fn(viewOf(s.node));
+        }
+    }
+
+    WorkerPool pool_;
+    int bandRows_;
+    int inputs_{ 0 };
+    std::vector<NodeDef> nodes_;
+    std::vector<Metric> metrics_;
+    std::vector<Sink> sinks_;
+
+    // Plan for W_ x H_ x C_ frames
+    bool planned_{ false };
+    int W_{ 0 }, H_{ 0 }, C_{ 0 };
+    std::vector<Pass> passes_;
+    int slots_{ 0 }, bands_{ 0 };
+    Arena arena_;
+    std::vector<uint8_t*> frames_, bandBuffers_, scratch_;   // scratch: blur rows or median histograms
+};
+
+} // namespace filter2d
@@ -0,0 +1,207 @@
+// Image quality metrics on 8-bit views: squared error, MSE, PSNR and SSIM.
+// Squared errors are accumulated in integers, so every result is exact and does
+// not depend on the SIMD width, the tiling or the thread count. The *Many calls
+// score several candidates against one ground truth in a single pass: each row
+// segment of the ground truth is loaded once and stays in L1 while every
+// candidate is compared against it.
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "q32_filter2d.hpp"
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace filter2d {
+
+// Sum of squared differences of n bytes. Differences are squared and pair-summed
+// in 16-bit lanes by madd; each 32-bit lane grows by at most 4 * 255^2 per step,
+// so lanes are widened into 64-bit totals every kSseBlockSteps steps.
+constexpr std::size_t kSseBlockSteps{ 8192 };
+
+inline std::uint64_t sumSquaredDiff(const uint8_t* a, const uint8_t* b, std::size_t n) {
+    std::uint64_t total{ 0 };
+    std::size_t i{ 0 };
+#if defined(__AVX2__)
+    const __m256i zero{ _mm256_setzero_si256() };
+    __m256i wide{ zero };
+    while (n - i >= 32) {
+        const std::size_t end{ i + std::min((n - i) / 32, kSseBlockSteps) * 32 };
+        __m256i acc{ zero };
+        for (; i < end; i += 32) {
+            const __m256i va{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)) };
+            const __m256i vb{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)) };
+            const __m256i lo{ _mm256_sub_epi16(_mm256_unpacklo_epi8(va, zero), _mm256_unpacklo_epi8(vb, zero)) };
+            const __m256i hi{ _mm256_sub_epi16(_mm256_unpackhi_epi8(va, zero), _mm256_unpackhi_epi8(vb, zero)) };
+            acc = _mm256_add_epi32(acc, _mm256_add_epi32(_mm256_madd_epi16(lo, lo), _mm256_madd_epi16(hi, hi)));
+        }
+        wide = _mm256_add_epi64(wide, _mm256_unpacklo_epi32(acc, zero));
+        wide = _mm256_add_epi64(wide, _mm256_unpackhi_epi32(acc, zero));
+    }
+    alignas(32) std::uint64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), wide);
+    total = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif defined(__SSE2__)
+    const __m128i zero{ _mm_setzero_si128() };
+    __m128i wide{ zero };
+    while (n - i >= 16) {
+        const std::size_t end{ i + std::min((n - i) / 16, kSseBlockSteps) * 16 };
+        __m128i acc{ zero };
+        for (; i < end; i += 16) {
+            const __m128i va{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)) };
+            const __m128i vb{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)) };
+            const __m128i lo{ _mm_sub_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero)) };
+            const __m128i hi{ _mm_sub_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero)) };
+            acc = _mm_add_epi32(acc, _mm_add_epi32(_mm_madd_epi16(lo, lo), _mm_madd_epi16(hi, hi)));
+        }
+        wide = _mm_add_epi64(wide, _mm_unpacklo_epi32(acc, zero));
+        wide = _mm_add_epi64(wide, _mm_unpackhi_epi32(acc, zero));
+    }
+    alignas(16) std::uint64_t lanes[2];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), wide);
+    total = lanes[0] + lanes[1];
+#endif
+    for (; i < n; ++i) {
+        const int d{ int(a[i]) - int(b[i]) };
+        total += std::uint64_t(d * d);
+    }
+    return total;
+}
+
+// Sums of squared differences of count candidates against gt (all the same size
+// and channel count, any stride), written to sse[0 .. count-1]
+inline void sumSquaredDiffMany(ImageView gt, const ImageView* tests, int count, std::uint64_t* sse,
+    const Tiling& tiling = {}) {
+    INSTR_SCOPE("q32.sse_many");
+    std::fill(sse, sse + count, std::uint64_t{ 0 });
+    std::mutex m;
+    const int ch{ gt.channels };
+    forEachTile(gt.height, gt.width, tiling, [&](int r0, int r1, int c0, int c1) {
+        std::vector<std::uint64_t> local(count, 0);
+        const std::size_t n{ std::size_t(c1 - c0) * ch };
+        for (int r{ r0 }; r < r1; ++r) {
+            const uint8_t* g{ gt.row(r) + std::size_t(c0) * ch };
+            for (int k{ 0 }; k < count; ++k) local[k] += sumSquaredDiff(g, tests[k].row(r) + std::size_t(c0) * ch, n);
+        }
+        std::lock_guard<std::mutex> lock{ m };
+        for (int k{ 0 }; k < count; ++k) sse[k] += local[k];
+        });
+}
+
+// Same rule as psnr8: identical images score 99 dB
+inline double psnrFromSse(std::uint64_t sse, std::uint64_t samples) {
+    if (sse == 0 || samples == 0) return 99.0;
+    const double m{ double(sse) / double(samples) };
+    return 10.0 * std::log10((255.0 * 255.0) / m);
+}
+
+inline void mseMany(ImageView gt, const ImageView* tests, int count, double* mse, const Tiling& tiling = {}) {
+    std::vector<std::uint64_t> sse(count);
+    sumSquaredDiffMany(gt, tests, count, sse.data(), tiling);
+    const double samples{ double(gt.width) * gt.height * gt.channels };
+    for (int k{ 0 }; k < count; ++k) mse[k] = samples > 0 ? double(sse[k]) / samples : 0.0;
+}
+
+inline void psnrMany(ImageView gt, const ImageView* tests, int count, double* psnr, const Tiling& tiling = {}) {
+    std::vector<std::uint64_t> sse(count);
+    sumSquaredDiffMany(gt, tests, count, sse.data(), tiling);
+    const std::uint64_t samples{ std::uint64_t(gt.width) * gt.height * gt.channels };
+    for (int k{ 0 }; k < count; ++k) psnr[k] = psnrFromSse(sse[k], samples);
+}
+
+inline double mse(ImageView gt, ImageView test, const Tiling& tiling = {}) {
+    double m;
+    mseMany(gt, &test, 1, &m, tiling);
+    return m;
+}
+
+inline double psnr(ImageView gt, ImageView test, const Tiling& tiling = {}) {
+    double p;
+    psnrMany(gt, &test, 1, &p, tiling);
+    return p;
+}
+
+// ---------- SSIM ----------
+
+// Mean SSIM over every 7x7 window that fits in the image (uniform weights, the
+// usual K1 = 0.01, K2 = 0.03), averaged over channels. Window sums are kept as
+// running integer column sums, so each pixel is added and removed once. Row bands
+// are scored in parallel and their partial sums added in band order, which keeps
+// the result independent of the thread count.
+inline double ssim(ImageView gt, ImageView test, const Tiling& tiling = {}) {
+    INSTR_SCOPE("q32.ssim");
+    const int ch{ gt.channels };
+    const int win{ std::min({ 7, gt.width, gt.height }) };
+    if (win <= 0) return 1.0;
+    const int outH{ gt.height - win + 1 }, outW{ gt.width - win + 1 };
+    const double N{ double(win) * win };
+    const double C1{ (0.01 * 255.0) * (0.01 * 255.0) * N * N };
+    const double C2{ (0.03 * 255.0) * (0.03 * 255.0) * N * N };
+
+    // Full-width bands so each band builds its column sums once
+    Tiling bands{ tiling };
+    bands.tileW = outW;
+    const int bandH{ std::max(1, bands.tileH) };
+    std::vector<double> partial((outH + bandH - 1) / bandH, 0.0);
+
+    forEachTile(outH, outW, bands, [&](int r0, int r1, int, int) {
+        // Column sums over the current win rows; unsigned wrap-around in the
+        // sliding updates cancels out, since every true sum fits in 32 bits
+        std::vector<std::uint32_t> sx(gt.width), sy(gt.width), sxx(gt.width), syy(gt.width), sxy(gt.width);
+        double acc{ 0.0 };
+        for (int c{ 0 }; c < ch; ++c) {
+            std::fill(sx.begin(), sx.end(), 0u); std::fill(sy.begin(), sy.end(), 0u);
+            std::fill(sxx.begin(), sxx.end(), 0u); std::fill(syy.begin(), syy.end(), 0u); std::fill(sxy.begin(), sxy.end(), 0u);
+            for (int r{ r0 }; r < r0 + win; ++r) {
+                const uint8_t* a{ gt.row(r) + c };
+                const uint8_t* b{ test.row(r) + c };
+                for (int x{ 0 }; x < gt.width; ++x) {
+                    const std::uint32_t u{ a[std::size_t(x) * ch] }, v{ b[std::size_t(x) * ch] };
+                    sx[x] += u; sy[x] += v; sxx[x] += u * u; syy[x] += v * v; sxy[x] += u * v;
+                }
+            }
+            for (int r{ r0 }; r < r1; ++r) {
+                if (r > r0) {
+                    const uint8_t* aOut{ gt.row(r - 1) + c };
+                    const uint8_t* bOut{ test.row(r - 1) + c };
+                    const uint8_t* aIn{ gt.row(r + win - 1) + c };
+                    const uint8_t* bIn{ test.row(r + win - 1) + c };
+                    for (int x{ 0 }; x < gt.width; ++x) {
+                        const std::size_t i{ std::size_t(x) * ch };
+                        const std::uint32_t u0{ aOut[i] }, v0{ bOut[i] }, u1{ aIn[i] }, v1{ bIn[i] };
+                        sx[x] += u1 - u0; sy[x] += v1 - v0;
+                        sxx[x] += u1 * u1 - u0 * u0; syy[x] += v1 * v1 - v0 * v0; sxy[x] += u1 * v1 - u0 * v0;
+                    }
+                }
+                std::uint32_t Sx{ 0 }, Sy{ 0 }, Sxx{ 0 }, Syy{ 0 }, Sxy{ 0 };
+                for (int x{ 0 }; x < win; ++x) { Sx += sx[x]; Sy += sy[x]; Sxx += sxx[x]; Syy += syy[x]; Sxy += sxy[x]; }
+                for (int x{ 0 }; x < outW; ++x) {
+                    if (x > 0) {
+                        const int in{ x + win - 1 }, out{ x - 1 };
+                        Sx += sx[in] - sx[out]; Sy += sy[in] - sy[out];
+                        Sxx += sxx[in] - sxx[out]; Syy += syy[in] - syy[out]; Sxy += sxy[in] - sxy[out];
+                    }
+                    // Means and (co)variances scaled by N^2, all exact in double
+                    const double mxy{ double(Sx) * double(Sy) };
+                    const double mxx{ double(Sx) * double(Sx) }, myy{ double(Sy) * double(Sy) };
+                    const double vx{ N * double(Sxx) - mxx }, vy{ N * double(Syy) - myy }, cxy{ N * double(Sxy) - mxy };
+                    acc += ((2.0 * mxy + C1) * (2.0 * cxy + C2)) / ((mxx + myy + C1) * (vx + vy + C2));
+                }
+            }
+        }
+        partial[r0 / bandH] = acc;
+        });
+
+    double total{ 0.0 };
+    for (double p : partial) total += p;
+    return total / (double(outH) * outW * ch);
+}
+
+} // namespace filter2d
@@ -0,0 +1,203 @@
+// Three-stage batch pipeline (decode -> filter -> encode) for processing many frames.
+// Each stage runs on its own threads; stages are connected by bounded queues, so a
+// slow stage applies back-pressure instead of letting decoded frames pile up. Work
+// items come from a fixed pool and are reused for every image: once the pool is warm,
+// buffers that keep their capacity (std::vector resized to the same or a smaller
+// frame) are never reallocated.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace filter2d {
+
+// FIFO with a capacity; push blocks while full, pop blocks while empty.
+// After close(), pop drains what is left and then returns false.
+template <class T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(std::size_t capacity) : capacity_{ std::max<std::size_t>(1, capacity) } {}
+
+    void push(T item) {
+        std::unique_lock<std::mutex> lock{ m_ };
+        notFull_.wait(lock, [&] { return items_.size() < capacity_; });
+        items_.push_back(std::move(item));
+        notEmpty_.notify_one();
+    }
+
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock{ m_ };
+        notEmpty_.wait(lock, [&] { return !items_.empty() || closed_; });
+        if (items_.empty()) return false;
+        item = std::move(items_.front());
+        items_.pop_front();
+        notFull_.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock{ m_ };
+        closed_ = true;
+        notEmpty_.notify_all();
+    }
+
+private:
+    std::mutex m_;
+    std::condition_variable notFull_, notEmpty_;
+    std::deque<T> items_;
+    std::size_t capacity_;
+    bool closed_{ false };
+};
+
+// Fixed set of reusable objects; acquire blocks until one is free
+template <class T>
+class ObjectPool {
+public:
+    explicit ObjectPool(std::size_t count) : objects_(std::max<std::size_t>(1, count)), free_{ objects_.size() } {
+        for (T& o : objects_) free_.push(&o);
+    }
+    T* acquire() { T* p{ nullptr }; free_.pop(p); return p; }
+    void release(T* p) { free_.push(p); }
+    std::size_t size() const { return objects_.size(); }
+
+private:
+    std::vector<T> objects_;
+    BoundedQueue<T*> free_;
+};
+
+struct PipelineOptions {
+    int decodeThreads{ 1 };
+    int filterThreads{ 1 };
+    int encodeThreads{ 1 };
+    std::size_t queueDepth{ 4 };   // per queue; the pool holds enough items to fill both
+};
+
+// Latency distribution of one stage, in milliseconds
+struct LatencySummary {
+    double mean{ 0.0 }, p50{ 0.0 }, p95{ 0.0 }, max{ 0.0 };
+};
+
+struct PipelineReport {
+    std::size_t images{ 0 };     // encoded successfully
+    std::size_t failed{ 0 };     // decode or encode returned false
+    std::size_t poolItems{ 0 };
+    double seconds{ 0.0 };
+    LatencySummary decode, filter, encode;
+    LatencySummary endToEnd;     // decode start to encode end, queue waits included
+};
+
+namespace detail {
+
+inline LatencySummary summarize(std::vector<double>& ms) {
+    LatencySummary s;
+    if (ms.empty()) return s;
+    std::sort(ms.begin(), ms.end());
+    double sum{ 0.0 };
+    for (double v : ms) sum += v;
+    s.mean = sum / double(ms.size());
+    s.p50 = ms[(ms.size() - 1) / 2];
+    s.p95 = ms[(ms.size() - 1) * 95 / 100];
+    s.max = ms.back();
+    return s;
+}
+
+} // namespace detail
+
+// Runs images 0 .. count-1 through the three stages:
+//   decode(index, item) -> bool   fills a pooled item; false skips the image
+//   filter(item)                  filters in place within the item
+//   encode(item) -> bool          writes the result out
+// Item must be default-constructible and should keep the index it was decoded for
+// if encode needs it. Images finish in any order.
+template <class Item, class Decode, class Filter, class Encode>
+PipelineReport runPipeline(std::size_t count, const PipelineOptions& options, Decode&& decode, Filter&& filter, Encode&& encode) {
+    using Clock = std::chrono::steady_clock;
+    struct Slot {
+        Item* item{ nullptr };
+        Clock::time_point start;
+    };
+    const int decodeThreads{ std::max(1, options.decodeThreads) };
+    const int filterThreads{ std::max(1, options.filterThreads) };
+    const int encodeThreads{ std::max(1, options.encodeThreads) };
+    const std::size_t depth{ std::max<std::size_t>(1, options.queueDepth) };
+
+    // One item per running stage thread plus a full queue on each link
+    ObjectPool<Item> pool{ std::size_t(decodeThreads + filterThreads + encodeThreads) + 2 * depth };
+    BoundedQueue<Slot> decoded{ depth }, filtered{ depth };
+
+    std::mutex statsMutex;
+    std::vector<double> decodeMs, filterMs, encodeMs, totalMs;
+    std::size_t images{ 0 }, failed{ 0 };
+    auto record = [&](std::vector<double>& into, Clock::time_point t0, Clock::time_point t1) {
+        std::lock_guard<std::mutex> lock{ statsMutex };
+        into.push_back(std::chrono::duration<double, std::milli>(t1 - t0).count());
+        };
+
+    std::atomic<std::size_t> next{ 0 };
+    std::atomic<int> decodersLeft{ decodeThreads }, filtersLeft{ filterThreads };
+
+    auto decodeWorker = [&] {
+        for (std::size_t i; (i = next.fetch_add(1)) < count;) {
+            Slot slot{ pool.acquire(), Clock::now() };
+            const bool ok{ decode(i, *slot.item) };
+            record(decodeMs, slot.start, Clock::now());
+            if (ok) {
+                decoded.push(slot);
+            }
+            else {
+                pool.release(slot.item);
+                std::lock_guard<std::mutex> lock{ statsMutex };
+                ++failed;
+            }
+        }
+        if (--decodersLeft == 0) decoded.close();
+        };
+    auto filterWorker = [&] {
+        for (Slot slot; decoded.pop(slot);) {
+            const auto t0{ Clock::now() };
+            filter(*slot.item);
+            record(filterMs, t0, Clock::now());
+            filtered.push(slot);
+        }
+        if (--filtersLeft == 0) filtered.close();
+        };
+    auto encodeWorker = [&] {
+        for (Slot slot; filtered.pop(slot);) {
+            const auto t0{ Clock::now() };
+            const bool ok{ encode(*slot.item) };
+            const auto t1{ Clock::now() };
+            pool.release(slot.item);
+            record(encodeMs, t0, t1);
+            record(totalMs, slot.start, t1);
+            std::lock_guard<std::mutex> lock{ statsMutex };
+            ++(ok ? images : failed);
+        }
+        };
+
+    const auto t0{ Clock::now() };
+    std::vector<std::thread> threads;
+    for (int t{ 0 }; t < decodeThreads; ++t) threads.emplace_back(decodeWorker);
+    for (int t{ 0 }; t < filterThreads; ++t) threads.emplace_back(filterWorker);
+    for (int t{ 0 }; t < encodeThreads; ++t) threads.emplace_back(encodeWorker);
+    for (std::thread& t : threads) t.join();
+
+    PipelineReport report;
+    report.seconds = std::chrono::duration<double>(Clock::now() - t0).count();
+    report.images = images;
+    report.failed = failed;
+    report.poolItems = pool.size();
+    report.decode = detail::summarize(decodeMs);
+    report.filter = detail::summarize(filterMs);
+    report.encode = detail::summarize(encodeMs);
+    report.endToEnd = detail::summarize(totalMs);
+    return report;
+}
+
+} // namespace filter2d
@@ -1,12 +1,24 @@
 // Requires: stb_image.h, stb_image_write.h in project folder
 #define _CRT_SECURE_NO_WARNINGS
+#include <cstddef>
+
+// stb allocates through the batch mode's per-frame codec heaps (see CodecHeap)
+void* codecMalloc(std::size_t size);
+void* codecRealloc(void* p, std::size_t size);
+void codecFree(void* p);
+#define STBI_MALLOC(sz) codecMalloc(sz)
+#define STBI_REALLOC(p, newsz) codecRealloc(p, newsz)
+#define STBI_FREE(p) codecFree(p)
+#define STBIW_MALLOC(sz) codecMalloc(sz)
+#define STBIW_REALLOC(p, newsz) codecRealloc(p, newsz)
+#define STBIW_FREE(p) codecFree(p)
+
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
 
 #include <cassert>
-#include <cstddef>
 #include <cstdint>
 #include <cstdio>
 #include <vector>
@@ -15,6 +27,22 @@
 #include <cmath>
 #include <random>
 #include <string>
+#include <chrono>
+#include <thread>
+#include <utility>
+#include <atomic>
+#include <cctype>
+#include <cstdlib>
+#include <filesystem>
+#include <map>
+#include <memory>
+
+#include "q32_filter2d.hpp"
+#include "q32_metrics.hpp"
+#include "q32_pipeline.hpp"
+#include "q32_graph.hpp"
+#include "noise.hpp"
+#include "instrument.hpp"
 
 // ---------- HELPER FUNCTIOS BELOW (DO NOT MODIFY) ----------
 template <class T> T clampv(T v, T lo, T hi) { return v < lo ? lo : (v > hi ? hi : v); }
@@ -48,116 +76,495 @@ void save_png(const std::string& fname,
 
 
 // YOUR MAIN (PLEASE FILL IN TODO's FROM HERE)
-int main() {
-    // Loading JPEG as grayscale and center-crop 256x256
-    int W_in, H_in, ch;
-    uint8_t* data = stbi_load("ground_truth.jpg", &W_in, &H_in, &ch, 1);
-    if (!data) { std::fprintf(stderr, "ERROR: cannot load ground_truth.jpg\n"); return 1; }
-    if (W_in < 256 || H_in < 256) {
-        std::fprintf(stderr, "ERROR: need at least 256x256, got %dx%d\n", W_in, H_in);
-        stbi_image_free(data); return 1;
-    }
-
-    const int H{ 256 }, W{ 256 };
-    const int r0{ H_in / 2 - H / 2 }, c0{ W_in / 2 - W / 2 };
-    std::vector<uint8_t> I_gt(H * W, 0);
-    for (int r{ 0 }; r < H; ++r) {
-        const uint8_t* src{ data + (r0 + r) * W_in };
-        uint8_t* dst{ I_gt.data() + r * W };
-        std::copy(src + c0, src + c0 + W, dst);
+
+// Compatibility noise: the original mt19937 generator, Gaussian pass then salt & pepper pass
+void addNoiseMt19937(std::vector<uint8_t>& I_noisy) {
+    std::mt19937 rng{ 4242u };
+    std::normal_distribution<double> gaus{ 0.0, 18.0 };
+    std::uniform_real_distribution<double> uni{ 0.0, 1.0 };
+
+    // Gaussian noise
+    for (std::size_t i{ 0 }; i < I_noisy.size(); ++i) {
+        const uint8_t& src{ I_noisy[i] };
+        double v{ double(src) + gaus(rng) };
+        uint8_t& dst{ I_noisy[i] };
+        dst = static_cast<uint8_t>(clampv<int>(int(std::lround(v)), 0, 255));
     }
-    stbi_image_free(data);
-    save_png("gt.png", I_gt, H, W);
-
-     // Generating noisy signal: Gaussian noise + salt/pepper
-     std::vector<uint8_t> I_noisy{ I_gt };
-     {
-         std::mt19937 rng{ 4242u };
-         std::normal_distribution<double> gaus{ 0.0, 18.0 };
-         std::uniform_real_distribution<double> uni{ 0.0, 1.0 };
-
-         // Gaussian noise
-         for (std::size_t i{ 0 }; i < I_noisy.size(); ++i) {
-             const uint8_t& src{ I_noisy[i] };
-             double v{ double(src) + gaus(rng) };
-             uint8_t& dst{ I_noisy[i] };
-             dst = static_cast<uint8_t>(clampv<int>(int(std::lround(v)), 0, 255));
-         }
-         // Salt & pepper noise
-         for (std::size_t i{ 0 }; i < I_noisy.size(); ++i) {
-             double p{ uni(rng) };
-             if (p < 0.01) { uint8_t& px{ I_noisy[i] }; px = 0; }
-             else if (p > 0.99) { uint8_t& px{ I_noisy[i] }; px = 255; }
-         }
-     }
-    save_png("noisy.png", I_noisy, H, W);
-
-    std::vector<uint8_t> I_blur_h{ I_noisy }, I_blur{ I_noisy };
-
-    // --- Horizontal pass for Gaussian blur ---
-    for (int r = 0; r < H; ++r) {
-        for (int c = 0; c < W; ++c) {
-            int c0{ reflect_index(c - 1, W) };
-            int c1{ c };
-            int c2{ reflect_index(c + 1, W) };
-
-            const uint8_t& a{ I_noisy[r * W + c0] };
-            const uint8_t& b{ I_noisy[r * W + c1] };
-            const uint8_t& c_val{ I_noisy[r * W + c2] };
-
-            double val = (static_cast<double>(a) + static_cast<double>(b) * 2.0 + static_cast<double>(c_val)) / 4.0;
-            I_blur_h[r * W + c] = static_cast<uint8_t>(clampv<int>(static_cast<int>(std::lround(val)), 0, 255));
+    // Salt & pepper noise
+    for (std::size_t i{ 0 }; i < I_noisy.size(); ++i) {
+        double p{ uni(rng) };
+        if (p < 0.01) { uint8_t& px{ I_noisy[i] }; px = 0; }
+        else if (p > 0.99) { uint8_t& px{ I_noisy[i] }; px = 255; }
+    }
+}
+
+// Saving a view (grayscale or RGB, any stride) as PNG
+void save_png(const std::string& fname, filter2d::ImageView img) {
+    INSTR_SCOPE("q32.save_png");
+    stbi_write_png(fname.c_str(), img.width, img.height, img.channels, img.data, int(img.stride));
+}
+
+// ---------- Batch mode ----------
+
+// Memory for stb's allocations during one decode or encode, owned by a pooled frame.
+// Allocations bump through one block and frees are no-ops; growing the most recent
+// allocation extends it in place. What does not fit goes to the C heap, and the
+// next reset() enlarges the block to the high-water mark, so a frame that has
+// already handled an image of this size decodes and encodes without allocating.
+// The decoded pixels stay in the block until the next reset().
+class CodecHeap {
+public:
+    CodecHeap() = default;
+    CodecHeap(const CodecHeap&) = delete;
+    CodecHeap& operator=(const CodecHeap&) = delete;
+    ~CodecHeap() { for (void* p : overflow_) std::free(p); }
+
+    // Drops every allocation
+    void reset() {
+        for (void* p : overflow_) std::free(p);
+        overflow_.clear();
+        if (peak_ > capacity_) {
+            capacity_ = peak_;
+            block_.reset(new unsigned char[capacity_]);
         }
+        used_ = 0;
+        peak_ = 0;
+        misses_ = 0;
     }
 
-    // --- Vertical pass for Gaussian blur ---
-    for (int r = 0; r < H; ++r) {
-        for (int c = 0; c < W; ++c) {
-            int r0{ reflect_index(r - 1, H) };
-            int r1{ r };
-            int r2{ reflect_index(r + 1, H) };
-            
-            const uint8_t& a{ I_blur_h[r0 * W + c] };
-            const uint8_t& b{ I_blur_h[r1 * W + c] };
-            const uint8_t& c_val{ I_blur_h[r2 * W + c] };
+    void* allocate(std::size_t size) {
+        const std::size_t need{ kHeader + roundUp(size) };
+        peak_ += need;
+        if (used_ + need > capacity_) {
+            void* p{ std::malloc(size ? size : 1) };
+            if (p) overflow_.push_back(p);
+            ++misses_;
+            return p;
+        }
+        unsigned char* p{ block_.get() + used_ + kHeader };
+        std::memcpy(p - kHeader, &size, sizeof size);
+        used_ += need;
+        return p;
+    }
 
-            double val = (static_cast<double>(a) + static_cast<double>(b) * 2.0 + static_cast<double>(c_val)) / 4.0;
-            I_blur[r * W + c] = static_cast<uint8_t>(clampv<int>(static_cast<int>(std::lround(val)), 0, 255));
+    void* reallocate(void* p, std::size_t size) {
+        if (!p) return allocate(size);
+        if (!owns(p)) {
+            void* q{ std::realloc(p, size ? size : 1) };
+            if (q) {
+                std::replace(overflow_.begin(), overflow_.end(), p, q);
+                peak_ += kHeader + roundUp(size);
+                ++misses_;
+            }
+            return q;
         }
+        unsigned char* b{ static_cast<unsigned char*>(p) };
+        std::size_t old;
+        std::memcpy(&old, b - kHeader, sizeof old);
+        const std::size_t end{ std::size_t(b - block_.get()) + roundUp(size) };
+        if (b + roundUp(old) == block_.get() + used_ && end <= capacity_) {   // last allocation: grow or shrink in place
+            if (end > used_) { peak_ += end - used_; used_ = end; }
+            std::memcpy(b - kHeader, &size, sizeof size);
+            return p;
+        }
+        void* q{ allocate(size) };
+        if (q) std::memcpy(q, p, std::min(old, size));
+        return q;
     }
-    save_png("blur.png", I_blur, H, W);
 
-    // --- 3x3 median filter ---
-    std::vector<uint8_t> I_med{ I_noisy };
-    for (int r = 0; r < H; ++r) {
-        for (int c = 0; c < W; ++c) {
-            int r0{ reflect_index(r - 1, H) }, r1{ r }, r2{ reflect_index(r + 1, H) };
-            int c0{ reflect_index(c - 1, W) }, c1{ c }, c2{ reflect_index(c + 1, W) };
-
-            const uint8_t& p00{ I_noisy[r0 * W + c0] };
-            const uint8_t& p01{ I_noisy[r0 * W + c1] };
-            const uint8_t& p02{ I_noisy[r0 * W + c2] };
-            const uint8_t& p10{ I_noisy[r1 * W + c0] };
-            const uint8_t& p11{ I_noisy[r1 * W + c1] };
-            const uint8_t& p12{ I_noisy[r1 * W + c2] };
-            const uint8_t& p20{ I_noisy[r2 * W + c0] };
-            const uint8_t& p21{ I_noisy[r2 * W + c1] };
-            const uint8_t& p22{ I_noisy[r2 * W + c2] };
-
-            std::array<uint8_t, 9> window{ p00, p01, p02, p10, p11, p12, p20, p21, p22 };
-            std::sort(window.begin(), window.end());
-            I_med[r * W + c] = window[4];
+    void release(void* p) {
+        if (!p || owns(p)) return;
+        const auto it{ std::find(overflow_.begin(), overflow_.end(), p) };
+        if (it != overflow_.end()) overflow_.erase(it);
+        std::free(p);
+    }
+
+    // Allocations since reset() that went to the C heap
+    int misses() const { return misses_; }
+
+    bool owns(const void* p) const {
+        const unsigned char* b{ static_cast<const unsigned char*>(p) };
+        return b >= block_.get() && b < block_.get() + capacity_;
+    }
+
+    // Heap of the decode or encode running on this thread (none: the C heap)
+    static thread_local CodecHeap* active;
+
+private:
+    static constexpr std::size_t kHeader{ 16 };   // holds the size, keeps 16-byte alignment
+    static std::size_t roundUp(std::size_t n) { return (n + kHeader - 1) / kHeader * kHeader; }
+
+    std::unique_ptr<unsigned char[]> block_;
+    std::size_t capacity_{ 0 }, used_{ 0 }, peak_{ 0 };
+    std::vector<void*> overflow_;
+    int misses_{ 0 };
+};
+
+thread_local CodecHeap* CodecHeap::active{ nullptr };
+
+void* codecMalloc(std::size_t size) {
+    return CodecHeap::active ? CodecHeap::active->allocate(size) : std::malloc(size);
+}
+
+void* codecRealloc(void* p, std::size_t size) {
+    return CodecHeap::active ? CodecHeap::active->reallocate(p, size) : std::realloc(p, size);
+}
+
+void codecFree(void* p) {
+    if (CodecHeap::active) CodecHeap::active->release(p);
+    else std::free(p);
+}
+
+// Routes this thread's stb allocations to heap, reset first, until the scope ends;
+// adds the allocations that missed the heap to misses
+struct CodecScope {
+    CodecScope(CodecHeap& heap, std::atomic<int>& misses) : heap_{ heap }, misses_{ misses } {
+        heap_.reset();
+        CodecHeap::active = &heap_;
+    }
+    ~CodecScope() {
+        CodecHeap::active = nullptr;
+        misses_ += heap_.misses();
+    }
+    CodecHeap& heap_;
+    std::atomic<int>& misses_;
+};
+
+// One pooled work item; its buffers and codec heaps keep their capacity from image
+// to image, so once the pool is warm a frame is decoded, filtered and encoded
+// without heap allocation (output paths and file I/O aside)
+struct BatchFrame {
+    std::size_t index{ 0 };
+    int W{ 0 }, H{ 0 }, C{ 1 };
+    std::vector<unsigned char> file;     // compressed input as read from disk
+    const uint8_t* pixels{ nullptr };    // decoded frame, in decodeHeap
+    std::vector<uint8_t> filtered;
+    CodecHeap decodeHeap, encodeHeap;
+};
+
+static bool readFile(const std::string& path, std::vector<unsigned char>& out) {
+    std::FILE* f{ std::fopen(path.c_str(), "rb") };
+    if (!f) return false;
+    std::fseek(f, 0, SEEK_END);
+    const long size{ std::ftell(f) };
+    std::fseek(f, 0, SEEK_SET);
+    out.resize(size > 0 ? std::size_t(size) : 0);
+    const bool ok{ size > 0 && std::fread(out.data(), 1, out.size(), f) == out.size() };
+    std::fclose(f);
+    return ok;
+}
+
+// Image files of a directory (sorted), or the paths listed one per line in a text file
+static std::vector<std::string> listInputs(const std::string& source) {
+    std::vector<std::string> paths;
+    if (std::filesystem::is_directory(source)) {
+        for (const auto& entry : std::filesystem::directory_iterator(source)) {
+            if (!entry.is_regular_file()) continue;
+            std::string ext{ entry.path().extension().string() };
+            for (char& c : ext) c = char(std::tolower((unsigned char)c));
+            if (ext == ".jpg" || ext == ".jpeg" || ext == ".png" || ext == ".bmp" || ext == ".tga")
+                paths.push_back(entry.path().string());
+        }
+        std::sort(paths.begin(), paths.end());
+    }
+    else if (std::FILE* f{ std::fopen(source.c_str(), "r") }) {
+        std::string line;
+        for (int c; (c = std::fgetc(f)) != EOF;) {
+            if (c != '\n' && c != '\r') { line += char(c); continue; }
+            if (!line.empty()) paths.push_back(line);
+            line.clear();
+        }
+        if (!line.empty()) paths.push_back(line);
+        std::fclose(f);
+    }
+    return paths;
+}
+
+// Output file names, <stem>.png, unique within the batch: inputs that share a stem
+// (a.jpg and a.png) keep their extension (a.jpg.png), and names that still clash
+// (the same file name in two listed directories) get the input's index appended
+static std::vector<std::string> outputNames(const std::vector<std::string>& paths) {
+    std::vector<std::string> names(paths.size());
+    std::map<std::string, int> stems, used;
+    for (const std::string& p : paths) ++stems[std::filesystem::path(p).stem().string()];
+    for (std::size_t i{ 0 }; i < paths.size(); ++i) {
+        const std::filesystem::path p{ paths[i] };
+        names[i] = (stems[p.stem().string()] > 1 ? p.filename().string() : p.stem().string()) + ".png";
+    }
+    for (const std::string& n : names) ++used[n];
+    for (std::size_t i{ 0 }; i < paths.size(); ++i) {
+        if (used[names[i]] > 1) names[i].insert(names[i].size() - 4, "-" + std::to_string(i));
+    }
+    return names;
+}
+
+static void printLatency(const char* stage, const filter2d::LatencySummary& s) {
+    std::printf("  %-8s mean %8.3f  p50 %8.3f  p95 %8.3f  max %8.3f ms\n", stage, s.mean, s.p50, s.p95, s.max);
+}
+
+// Filters every image of a directory or file list into outDir/<stem>.png on a
+// decode -> filter -> encode pipeline. filterName: blur, median (3x3) or median5.
+static int runBatch(const std::string& source, const std::string& outDir, int C, const std::string& filterName,
+    const filter2d::PipelineOptions& options) {
+    const std::vector<std::string> paths{ listInputs(source) };
+    if (paths.empty()) { std::fprintf(stderr, "ERROR: no images in %s\n", source.c_str()); return 1; }
+    const std::vector<std::string> names{ outputNames(paths) };
+    if (filterName != "blur" && filterName != "median" && filterName != "median5") {
+        std::fprintf(stderr, "ERROR: unknown filter %s\n", filterName.c_str());
+        return 1;
+    }
+    std::error_code ec;
+    std::filesystem::create_directories(outDir, ec);
+
+    std::atomic<long long> pixels{ 0 };
+    std::atomic<int> heapMisses{ 0 };
+    auto decode = [&](std::size_t i, BatchFrame& f) {
+        INSTR_SCOPE("q32.batch.decode");
+        f.index = i;
+        if (!readFile(paths[i], f.file)) return false;
+        int ch;
+        CodecScope scope{ f.decodeHeap, heapMisses };
+        f.pixels = stbi_load_from_memory(f.file.data(), int(f.file.size()), &f.W, &f.H, &ch, C);
+        f.C = C;
+        return f.pixels != nullptr;
+        };
+    auto filter = [&](BatchFrame& f) {
+        INSTR_SCOPE("q32.batch.filter");
+        f.filtered.resize(std::size_t(f.W) * f.H * f.C);
+        const filter2d::ImageView src{ filter2d::packedView(f.pixels, f.H, f.W, f.C) };
+        const filter2d::MutableImageView dst{ filter2d::packedView(f.filtered.data(), f.H, f.W, f.C) };
+        if (filterName == "blur") filter2d::blur121(src, dst);
+        else if (filterName == "median") filter2d::median3x3(src, dst);
+        else filter2d::medianHistogram(src, dst, 2);
+        pixels += (long long)f.W * f.H;
+        };
+    // The PNG is built in the frame's encode heap and written from there
+    auto encode = [&](BatchFrame& f) {
+        INSTR_SCOPE("q32.batch.encode");
+        const std::string out{ (std::filesystem::path(outDir) / names[f.index]).string() };
+        std::FILE* file{ std::fopen(out.c_str(), "wb") };
+        if (!file) return false;
+        struct Sink { std::FILE* file; bool ok; } sink{ file, true };
+        auto write = [](void* context, void* bytes, int size) {
+            auto* s{ static_cast<Sink*>(context) };
+            s->ok = s->ok && std::fwrite(bytes, 1, std::size_t(size), s->file) == std::size_t(size);
+            };
+        bool ok;
+        {
+            CodecScope scope{ f.encodeHeap, heapMisses };
+            ok = stbi_write_png_to_func(write, &sink, f.W, f.H, f.C, f.filtered.data(), f.W * f.C) != 0;
+        }
+        return std::fclose(file) == 0 && ok && sink.ok;
+        };
+
+    const filter2d::PipelineReport r{ filter2d::runPipeline<BatchFrame>(paths.size(), options, decode, filter, encode) };
+    std::printf("Batch %s: %zu images, %zu failed, %.3f s\n", filterName.c_str(), r.images, r.failed, r.seconds);
+    std::printf("  threads decode/filter/encode: %d/%d/%d, queue depth %zu, %zu pooled frames\n",
+        options.decodeThreads, options.filterThreads, options.encodeThreads, options.queueDepth, r.poolItems);
+    std::printf("  codec allocations outside the frame heaps: %d\n", heapMisses.load());
+    std::printf("  %.2f images/sec, %.2f megapixels/sec\n", double(r.images) / r.seconds, double(pixels) / 1e6 / r.seconds);
+    printLatency("decode", r.decode);
+    printLatency("filter", r.filter);
+    printLatency("encode", r.encode);
+    printLatency("total", r.endToEnd);
+    instrument::report(stdout);
+    return r.failed ? 2 : 0;
+}
+
+// Usage: q32 [image.jpg] [--rgb] [--mt19937] [--bench]
+//   --bench: also time noise, filters, thread scaling and metrics on a 4096x4096 frame
+//        q32 --batch <dir|list.txt> <outdir> [--rgb] [--filter blur|median|median5]
+//            [--threads decode,filter,encode] [--queue N]
+int main(int argc, char** argv) {
+    // Loading the full frame as grayscale (or RGB with --rgb), any size, no crop
+    const char* path{ "ground_truth.jpg" };
+    int C{ 1 };
+    const char* batchSource{ nullptr };
+    const char* batchOut{ nullptr };
+    std::string filterName{ "median" };
+    bool mt19937Noise{ false }, bench{ false };
+    // Decode and encode (JPEG inflate, PNG deflate) cost more than the filters
+    const int hw{ int(std::max(1u, std::thread::hardware_concurrency())) };
+    filter2d::PipelineOptions options;
+    options.filterThreads = std::max(1, hw / 4);
+    options.encodeThreads = std::max(1, (hw - options.filterThreads) / 2);
+    options.decodeThreads = std::max(1, hw - options.filterThreads - options.encodeThreads);
+    for (int i{ 1 }; i < argc; ++i) {
+        const std::string arg{ argv[i] };
+        if (arg == "--rgb") C = 3;
+        else if (arg == "--mt19937") mt19937Noise = true;
+        else if (arg == "--bench") bench = true;
+        else if (arg == "--batch" && i + 2 < argc) { batchSource = argv[++i]; batchOut = argv[++i]; }
+        else if (arg == "--filter" && i + 1 < argc) filterName = argv[++i];
+        else if (arg == "--queue" && i + 1 < argc) options.queueDepth = std::size_t(std::max(1, std::atoi(argv[++i])));
+        else if (arg == "--threads" && i + 1 < argc) {
+            if (std::sscanf(argv[++i], "%d,%d,%d", &options.decodeThreads, &options.filterThreads, &options.encodeThreads) != 3) {
+                std::fprintf(stderr, "ERROR: --threads expects decode,filter,encode\n");
+                return 1;
+            }
         }
+        else path = argv[i];
+    }
+    if (batchSource) return runBatch(batchSource, batchOut, C, filterName, options);
+    int W, H, ch;
+    uint8_t* data;
+    {
+        INSTR_SCOPE("q32.load");
+        data = stbi_load(path, &W, &H, &ch, C);
+    }
+    if (!data) { std::fprintf(stderr, "ERROR: cannot load %s\n", path); return 1; }
+
+    const std::size_t frameBytes{ std::size_t(W) * H * C };
+    const filter2d::ImageView I_gt{ data, W, H, std::ptrdiff_t(W) * C, C };
+    save_png("gt.png", I_gt);
+
+    // Noise, both filters and the metrics as one filter graph: besides gt, only the
+    // noisy frame and one output frame (blur, then reused for median) are stored
+    filter2d::FilterGraph graph;
+    const auto gt{ graph.input() };
+
+    // Generating noisy signal: Gaussian noise + salt/pepper (the compatibility
+    // generator runs up front and feeds the graph as a second input)
+    std::vector<uint8_t> I_noisyMt;
+    if (mt19937Noise) {
+        I_noisyMt.assign(data, data + frameBytes);
+        addNoiseMt19937(I_noisyMt);
     }
-    save_png("median.png", I_med, H, W);
+    const auto noisy{ mt19937Noise ? graph.input() : graph.noise(gt, noise::ImageNoise{ 18.0, 0.01 }, 4242u) };
+
+    // --- Separable Gaussian blur (horizontal and vertical passes fused) ---
+    const auto blur{ graph.blur121(noisy) };
 
+    // --- 3x3 median filter ---
+    const auto med{ graph.median(noisy, 1) };
+
+    // --- Switching 3x3 median: only impulse candidates are replaced ---
+    const auto adaptive{ graph.switchingMedian(noisy) };
 
     // ---- Report PSNRs ----
-    std::printf("PSNR (dB) vs gt:\n");
-    std::printf("  noisy : %.2f\n", psnr8(I_gt, I_noisy));
-    std::printf("  blur  : %.2f\n", psnr8(I_gt, I_blur));
-    std::printf("  median: %.2f\n", psnr8(I_gt, I_med));
+    // Each candidate is scored band by band as it is produced
+    double psnr[4], ssimScore[4];
+    graph.psnr(gt, noisy, &psnr[0]);
+    graph.psnr(gt, blur, &psnr[1]);
+    graph.psnr(gt, med, &psnr[2]);
+    graph.psnr(gt, adaptive, &psnr[3]);
+    auto saveAndScore = [&](const char* fname, double* score) {
+        return [&I_gt, fname, score](filter2d::ImageView v) {
+            save_png(fname, v);
+            *score = filter2d::ssim(I_gt, v);
+            };
+        };
+    graph.sink(noisy, saveAndScore("noisy.png", &ssimScore[0]));
+    graph.sink(blur, saveAndScore("blur.png", &ssimScore[1]));
+    graph.sink(med, saveAndScore("median.png", &ssimScore[2]));
+    graph.sink(adaptive, saveAndScore("adaptive.png", &ssimScore[3]));
+    if (mt19937Noise) graph.run({ I_gt, filter2d::packedView(std::as_const(I_noisyMt).data(), H, W, C) });
+    else graph.run({ I_gt });
+
+    std::printf("PSNR (dB) vs gt (%dx%d, %d channel%s):\n", W, H, C, C > 1 ? "s" : "");
+    std::printf("  noisy : %.2f  (SSIM %.4f)\n", psnr[0], ssimScore[0]);
+    std::printf("  blur  : %.2f  (SSIM %.4f)\n", psnr[1], ssimScore[1]);
+    std::printf("  median: %.2f  (SSIM %.4f)\n", psnr[2], ssimScore[2]);
+    std::printf("  switch: %.2f  (SSIM %.4f)\n", psnr[3], ssimScore[3]);
+    std::printf("Filter graph: %d frame buffers + input, %d-row band buffers, arena %.1f MB\n",
+        graph.frameBuffers(), graph.bandRows(), double(graph.arenaBytes()) / 1e6);
 
-    std::puts("Saved: gt.png, noisy.png, blur.png, median.png");
+    std::puts("Saved: gt.png, noisy.png, blur.png, median.png, adaptive.png");
+
+    // ---- Filter timing on a large grayscale frame tiled from the image, then noised ----
+    if (bench) {
+        const int HL{ 4096 }, WL{ 4096 };
+        std::vector<uint8_t> bigClean(std::size_t(HL) * WL), bigOut(bigClean.size());
+        for (int r{ 0 }; r < HL; ++r)
+            for (int c{ 0 }; c < WL; ++c) bigClean[std::size_t(r) * WL + c] = data[(std::size_t(r % H) * W + (c % W)) * C];
+        std::vector<uint8_t> big{ bigClean };
+        noise::addImageNoise(big.data(), big.size(), {}, 4242u);
+        auto msPerMP = [&](auto&& run) {
+            auto t0{ std::chrono::steady_clock::now() };
+            run();
+            auto t1{ std::chrono::steady_clock::now() };
+            return std::chrono::duration<double, std::milli>(t1 - t0).count() / (double(HL) * WL / 1e6);
+            };
+        std::printf("Timing on %dx%d (ms/megapixel):\n", WL, HL);
+        {
+            // Noise generation: the compatibility generator against the fused counter-based one
+            std::vector<uint8_t> m(big), a(big), b(big);
+            double mt{ msPerMP([&] { addNoiseMt19937(m); }) };
+            double one{ msPerMP([&] { noise::addImageNoise(a.data(), a.size(), {}, 4242u, 1); }) };
+            double all{ msPerMP([&] { noise::addImageNoise(b.data(), b.size(), {}, 4242u, hw); }) };
+            std::printf("  noise mt19937: %.3f  philox (1 thread): %.3f  philox (%d threads): %.3f%s\n",
+                mt, one, hw, all, a == b ? "" : "  (OUTPUT DIFFERS)");
+        }
+        std::printf("  median 31x31 (1 thread): %.3f\n",
+            msPerMP([&] { filter2d::medianHistogram(big.data(), bigOut.data(), HL, WL, 15); }));
+
+        // Scaling across threads; outputs must not depend on the thread count
+        std::vector<uint8_t> refBlur(big.size()), refMed(big.size()), refMed5(big.size()), refSwitch(big.size());
+        std::vector<int> counts;
+        for (int t{ 1 }; t < hw; t *= 2) counts.push_back(t);
+        counts.push_back(hw);
+        for (int t : counts) {
+            filter2d::Tiling tiling{ t };
+            auto matches = [&](std::vector<uint8_t>& ref) {
+                if (t == 1) { ref = bigOut; return true; }
+                return bigOut == ref;
+                };
+            double blur{ msPerMP([&] { filter2d::blur121Tiled(big.data(), bigOut.data(), HL, WL, tiling); }) };
+            bool same{ matches(refBlur) };
+            double med{ msPerMP([&] { filter2d::median3x3Tiled(big.data(), bigOut.data(), HL, WL, tiling); }) };
+            same = matches(refMed) && same;
+            double med5{ msPerMP([&] { filter2d::medianHistogramTiled(big.data(), bigOut.data(), HL, WL, 2, tiling); }) };
+            same = matches(refMed5) && same;
+            double sw{ msPerMP([&] { filter2d::switchingMedian3x3Tiled(big.data(), bigOut.data(), HL, WL, filter2d::kImpulseThreshold, tiling); }) };
+            same = matches(refSwitch) && same;
+            std::printf("  threads=%-3d blur: %.3f  median 3x3: %.3f  median 5x5: %.3f  switching 3x3: %.3f%s\n",
+                t, blur, med, med5, sw, same ? "" : "  (OUTPUT DIFFERS)");
+        }
+
+        // Scoring the three outputs: one scalar psnr8 call each against a single pass
+        double scalarPsnr[3], fastPsnr[3];
+        double scalar{ msPerMP([&] {
+            scalarPsnr[0] = psnr8(big, refBlur);
+            scalarPsnr[1] = psnr8(big, refMed);
+            scalarPsnr[2] = psnr8(big, refMed5);
+            }) };
+        const filter2d::ImageView outputs[]{ filter2d::packedView(std::as_const(refBlur).data(), HL, WL),
+            filter2d::packedView(std::as_const(refMed).data(), HL, WL), filter2d::packedView(std::as_const(refMed5).data(), HL, WL) };
+        const filter2d::ImageView bigView{ filter2d::packedView(std::as_const(big).data(), HL, WL) };
+        double fast{ msPerMP([&] { filter2d::psnrMany(bigView, outputs, 3, fastPsnr); }) };
+        double ssimMs{ msPerMP([&] { filter2d::ssim(bigView, outputs[0]); }) };
+        const bool samePsnr{ std::equal(scalarPsnr, scalarPsnr + 3, fastPsnr) };
+        std::printf("  PSNR of 3 outputs: psnr8 x3: %.3f  psnrMany: %.3f%s  SSIM (1 output): %.3f\n",
+            scalar, fast, samePsnr ? "" : "  (PSNR DIFFERS)", ssimMs);
+
+        // The whole chain as separate full-frame calls against the filter graph
+        {
+            const filter2d::ImageView cleanView{ filter2d::packedView(std::as_const(bigClean).data(), HL, WL) };
+            std::vector<uint8_t> n(big.size()), b(big.size()), m(big.size());
+            double separatePsnr[3], graphPsnr[3];
+            double separate{ msPerMP([&] {
+                n = bigClean;
+                noise::addImageNoise(n.data(), n.size(), {}, 4242u);
+                filter2d::blur121Tiled(n.data(), b.data(), HL, WL);
+                filter2d::median3x3Tiled(n.data(), m.data(), HL, WL);
+                const filter2d::ImageView outs[]{ filter2d::packedView(std::as_const(n).data(), HL, WL),
+                    filter2d::packedView(std::as_const(b).data(), HL, WL), filter2d::packedView(std::as_const(m).data(), HL, WL) };
+                filter2d::psnrMany(cleanView, outs, 3, separatePsnr);
+                }) };
+            filter2d::FilterGraph g;
+            const auto in{ g.input() };
+            const auto gn{ g.noise(in, {}, 4242u) };
+            g.psnr(in, gn, &graphPsnr[0]);
+            g.psnr(in, g.blur121(gn), &graphPsnr[1]);
+            g.psnr(in, g.median(gn, 1), &graphPsnr[2]);
+            g.run({ cleanView });   // plans the run and sizes the arena
+            double fused{ msPerMP([&] { g.run({ cleanView }); }) };
+            const bool same{ std::equal(separatePsnr, separatePsnr + 3, graphPsnr) };
+            std::printf("  noise+blur+median+PSNR: separate calls (4 frames): %.3f  graph (%d frame + bands): %.3f%s\n",
+                separate, g.frameBuffers(), fused, same ? "" : "  (PSNR DIFFERS)");
+        }
+    }
+    stbi_image_free(data);
+    instrument::report(stdout);
     return 0;
 }
\ No newline at end of file